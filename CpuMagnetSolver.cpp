@@ -0,0 +1,480 @@
+//
+// Created by Elijah Crain on 10/17/26.
+//
+#pragma once
+
+#include "Util.cpp"
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <vector>
+#include <array>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <utility>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <cstdint>
+#include <cmath>
+
+// x86 builds stay baseline so they run on any x86-64 host; only the AVX2 kernel is compiled for
+// AVX2, and it is used only where cpuHasAvx2() says the CPU supports it. FMA is left out so the
+// kernel rounds exactly like the scalar one.
+#if defined(__x86_64__) || defined(_M_X64)
+#define VULKAN_MAGNETS_AVX2_KERNEL 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Kernel templates are forced inline, at every optimization level, into the function that picks
+// the lane type, so the AVX2 instantiation only ever runs inside the AVX2-compiled entry point and
+// no __m256 crosses a call between code built for different targets.
+#if defined(_MSC_VER)
+#define KERNEL_INLINE __forceinline
+#else
+#define KERNEL_INLINE __attribute__((always_inline)) inline
+#endif
+
+// Lanes of one float register for the kernels below: AVX2 on x86 where the CPU has it, NEON on
+// AArch64, otherwise a single float. Only the handful of operations the solver needs are wrapped.
+struct ScalarFloat {
+  static constexpr size_t WIDTH = 1;
+  float v;
+
+  static ScalarFloat load(const float *p) { return {*p}; }
+  static ScalarFloat set(float x) { return {x}; }
+  static ScalarFloat gather(const float *base, const uint32_t *indices) { return {base[*indices]}; }
+  void store(float *p) const { *p = v; }
+  friend ScalarFloat operator+(ScalarFloat a, ScalarFloat b) { return {a.v + b.v}; }
+  friend ScalarFloat operator-(ScalarFloat a, ScalarFloat b) { return {a.v - b.v}; }
+  friend ScalarFloat operator*(ScalarFloat a, ScalarFloat b) { return {a.v * b.v}; }
+  friend ScalarFloat floor(ScalarFloat a) { return {std::floor(a.v)}; }
+};
+
+#if defined(VULKAN_MAGNETS_AVX2_KERNEL)
+struct SimdFloat {
+  static constexpr size_t WIDTH = 8;
+  __m256 v;
+
+  AVX2_TARGET static SimdFloat load(const float *p) { return {_mm256_loadu_ps(p)}; }
+  AVX2_TARGET static SimdFloat set(float x) { return {_mm256_set1_ps(x)}; }
+  AVX2_TARGET static SimdFloat gather(const float *base, const uint32_t *indices) {
+    return {_mm256_i32gather_ps(base, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indices)), 4)};
+  }
+  AVX2_TARGET void store(float *p) const { _mm256_storeu_ps(p, v); }
+  AVX2_TARGET friend SimdFloat operator+(SimdFloat a, SimdFloat b) { return {_mm256_add_ps(a.v, b.v)}; }
+  AVX2_TARGET friend SimdFloat operator-(SimdFloat a, SimdFloat b) { return {_mm256_sub_ps(a.v, b.v)}; }
+  AVX2_TARGET friend SimdFloat operator*(SimdFloat a, SimdFloat b) { return {_mm256_mul_ps(a.v, b.v)}; }
+  AVX2_TARGET friend SimdFloat floor(SimdFloat a) { return {_mm256_floor_ps(a.v)}; }
+};
+
+inline bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  // The OS has to save the YMM registers too.
+  bool osAvx = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+  __cpuidex(info, 7, 0);
+  return osAvx && (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+struct SimdFloat {
+  static constexpr size_t WIDTH = 4;
+  float32x4_t v;
+
+  static SimdFloat load(const float *p) { return {vld1q_f32(p)}; }
+  static SimdFloat set(float x) { return {vdupq_n_f32(x)}; }
+  // NEON has no gather; four scalar loads into one register.
+  static SimdFloat gather(const float *base, const uint32_t *indices) {
+    float lanes[4] = {base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]]};
+    return {vld1q_f32(lanes)};
+  }
+  void store(float *p) const { vst1q_f32(p, v); }
+  friend SimdFloat operator+(SimdFloat a, SimdFloat b) { return {vaddq_f32(a.v, b.v)}; }
+  friend SimdFloat operator-(SimdFloat a, SimdFloat b) { return {vsubq_f32(a.v, b.v)}; }
+  friend SimdFloat operator*(SimdFloat a, SimdFloat b) { return {vmulq_f32(a.v, b.v)}; }
+  friend SimdFloat floor(SimdFloat a) { return {vrndmq_f32(a.v)}; }
+};
+#else
+using SimdFloat = ScalarFloat;
+#endif
+
+// Whether SimdFloat is wider than one float and the CPU can run it.
+inline bool simdKernelAvailable() {
+#if defined(VULKAN_MAGNETS_AVX2_KERNEL)
+  return cpuHasAvx2();
+#else
+  return SimdFloat::WIDTH > 1;
+#endif
+}
+
+// Fixed set of threads that run one task at a time, the calling thread included.
+class WorkerPool {
+  public:
+    explicit WorkerPool(uint32_t threadCount) {
+      threadCount = std::max<uint32_t>(threadCount, 1);
+      for (uint32_t i = 1; i < threadCount; i++) {
+        threads.emplace_back([this, i] { workerLoop(i); });
+      }
+    }
+
+    ~WorkerPool() {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+      }
+      startCondition.notify_all();
+      for (auto &thread : threads) {
+        thread.join();
+      }
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    // Calls task(worker) once for every worker index and returns when all calls have finished.
+    void run(const std::function<void(uint32_t)> &task) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentTask = &task;
+        remaining = static_cast<uint32_t>(threads.size());
+        generation++;
+      }
+      startCondition.notify_all();
+      task(0);
+
+      std::unique_lock<std::mutex> lock(mutex);
+      doneCondition.wait(lock, [this] { return remaining == 0; });
+      currentTask = nullptr;
+    }
+
+    [[nodiscard]] uint32_t getThreadCount() const { return static_cast<uint32_t>(threads.size()) + 1; }
+
+  private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable startCondition;
+    std::condition_variable doneCondition;
+    const std::function<void(uint32_t)> *currentTask = nullptr;
+    uint64_t generation = 0;
+    uint32_t remaining = 0;
+    bool stopping = false;
+
+    void workerLoop(uint32_t worker) {
+      uint64_t seen = 0;
+      while (true) {
+        const std::function<void(uint32_t)> *task;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          startCondition.wait(lock, [&] { return stopping || generation != seen; });
+          if (stopping) {
+            return;
+          }
+          seen = generation;
+          task = currentTask;
+        }
+        (*task)(worker);
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          remaining--;
+        }
+        doneCondition.notify_one();
+      }
+    }
+};
+
+// CPU integration of the magnet lattice for hosts without a usable GPU, with the same physics as
+// magnets.comp. State is kept as structure-of-arrays in colour order: the hex lattice is
+// 3-coloured so no two neighbours share a colour, and each step updates the colours one after
+// another in place. Within a colour every magnet only reads the other two, so a colour can be
+// split across threads freely; chunks are aligned to whole SIMD registers, so every magnet always
+// goes through the same code path and results do not depend on the thread count.
+class CpuMagnetSolver {
+  public:
+    // Multiple of every SIMD width; also keeps threads off each other's cache lines.
+    static constexpr size_t CHUNK_ALIGNMENT = 64;
+
+    // threadCount 0 uses every hardware thread. allowSimd false forces the scalar kernel, which
+    // is otherwise only used where the CPU lacks the SIMD one.
+    CpuMagnetSolver(const MagnetSimulationConfig &config, uint32_t threadCount = 0, bool allowSimd = true)
+      : config(config),
+        pool(threadCount != 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency())),
+        simd(allowSimd && simdKernelAvailable()) {
+      if (config.stepsPerFrame == 0 || config.timeStep <= 0.0f || config.inertia <= 0.0f) {
+        throw std::runtime_error("invalid magnet simulation parameters!");
+      }
+    }
+
+    // Replaces the lattice. `magnets` is in grid order (y * width + x); `slots` maps each cell to
+    // its instance as in VulkanMagnetSimulation. spacing is the nearest-neighbour distance.
+    void setLattice(int width,
+                    int height,
+                    const std::vector<InstanceData> &magnets,
+                    const std::vector<uint32_t> &slots,
+                    float spacing) {
+      const size_t count = static_cast<size_t>(width) * static_cast<size_t>(height);
+      if (magnets.size() != count || slots.size() != count) {
+        throw std::runtime_error("magnet lattice does not match its grid size!");
+      }
+
+      // Axial coordinates of the odd-row-shifted layout are (x - floor(y / 2), y); q - r mod 3
+      // differs between any two neighbours.
+      auto colourOf = [](int x, int y) {
+        int q = x - (y - (y & 1)) / 2;
+        return static_cast<uint32_t>(((q - y) % 3 + 3) % 3);
+      };
+
+      std::array<size_t, 4> colourStart{};
+      for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+          colourStart[colourOf(x, y) + 1]++;
+        }
+      }
+      for (size_t c = 1; c < colourStart.size(); c++) {
+        colourStart[c] += colourStart[c - 1];
+      }
+      colourBegin = {colourStart[0], colourStart[1], colourStart[2]};
+      colourEnd = {colourStart[1], colourStart[2], colourStart[3]};
+
+      // One ghost magnet at `count` with sin = cos = 0 stands in for missing neighbours.
+      std::vector<uint32_t> orderOf(count);
+      auto next = colourStart;
+      for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+          orderOf[static_cast<size_t>(y) * width + x] = static_cast<uint32_t>(next[colourOf(x, y)]++);
+        }
+      }
+
+      magnetCount = count;
+      positionX.assign(count, 0.0f);
+      positionY.assign(count, 0.0f);
+      angle.assign(count, 0.0f);
+      angularVelocity.assign(count, 0.0f);
+      sinAngle.assign(count + 1, 0.0f);
+      cosAngle.assign(count + 1, 0.0f);
+      instanceSlot.assign(count, 0);
+      for (auto &indices : neighbours) {
+        indices.assign(count, static_cast<uint32_t>(count));
+      }
+      coefficientSin.fill(0.0f);
+      coefficientCos.fill(0.0f);
+
+      for (int y = 0; y < height; y++) {
+        // Same neighbour order as magnets.comp.
+        int shift = (y & 1) == 1 ? 0 : -1;
+        for (int x = 0; x < width; x++) {
+          size_t cell = static_cast<size_t>(y) * width + x;
+          uint32_t i = orderOf[cell];
+          positionX[i] = magnets[cell].offset.x;
+          positionY[i] = magnets[cell].offset.y;
+          angle[i] = magnets[cell].angle;
+          angularVelocity[i] = magnets[cell].angularVelocity;
+          sinAngle[i] = std::sin(angle[i]);
+          cosAngle[i] = std::cos(angle[i]);
+          instanceSlot[i] = slots[cell];
+
+          const std::array<glm::ivec2, 6> around{
+            glm::ivec2(x - 1, y), glm::ivec2(x + 1, y),
+            glm::ivec2(x + shift, y - 1), glm::ivec2(x + shift + 1, y - 1),
+            glm::ivec2(x + shift, y + 1), glm::ivec2(x + shift + 1, y + 1)
+          };
+          for (size_t d = 0; d < around.size(); d++) {
+            if (around[d].x < 0 || around[d].y < 0 || around[d].x >= width || around[d].y >= height) {
+              continue;
+            }
+            size_t otherCell = static_cast<size_t>(around[d].y) * width + around[d].x;
+            neighbours[d][i] = orderOf[otherCell];
+            if (coefficientCos[d] == 0.0f) {
+              setDirection(d, (magnets[otherCell].offset - magnets[cell].offset) / spacing);
+            }
+          }
+        }
+      }
+    }
+
+    // Advances stepsPerFrame steps.
+    void step() {
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t s = 0; s < config.stepsPerFrame; s++) {
+        double phase = 2.0 * glm::pi<double>() * std::fmod(config.fieldFrequency * simulatedSeconds, 1.0);
+        fieldY = config.fieldStrength * static_cast<float>(std::sin(phase));
+        fieldZ = config.fieldStrength * static_cast<float>(std::cos(phase));
+        for (uint32_t colour = 0; colour < 3; colour++) {
+          pool.run([&](uint32_t worker) {
+            auto [begin, end] = chunk(colourBegin[colour], colourEnd[colour], worker);
+            updateRange(begin, end);
+          });
+        }
+        simulatedSeconds += config.timeStep;
+        stepCount++;
+      }
+      solveNs += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    // Writes the current state into `instances` in instance order, as InstanceData or
+    // CompactInstance records.
+    template <typename Instance>
+    void pack(Instance *instances) {
+      pool.run([&](uint32_t worker) {
+        auto [begin, end] = chunk(0, magnetCount, worker);
+        for (size_t i = begin; i < end; i++) {
+          InstanceData state;
+          state.offset = glm::vec2(positionX[i], positionY[i]);
+          state.angle = angle[i];
+          state.angularVelocity = angularVelocity[i];
+          instances[instanceSlot[i]] = Instance(state);
+        }
+      });
+    }
+
+    [[nodiscard]] uint64_t getStepCount() const { return stepCount; }
+    [[nodiscard]] uint32_t getStepsPerFrame() const { return config.stepsPerFrame; }
+    [[nodiscard]] uint32_t getThreadCount() const { return pool.getThreadCount(); }
+    [[nodiscard]] bool usesSimd() const { return simd; }
+    // State in colour order, for comparing runs.
+    [[nodiscard]] const std::vector<float> &getAngles() const { return angle; }
+    [[nodiscard]] const std::vector<float> &getAngularVelocities() const { return angularVelocity; }
+    // Wall time spent in step(), summed over every call.
+    [[nodiscard]] uint64_t getSolveNanoseconds() const { return solveNs; }
+
+  private:
+    MagnetSimulationConfig config;
+    WorkerPool pool;
+    bool simd;
+
+    size_t magnetCount = 0;
+    std::array<size_t, 3> colourBegin{};
+    std::array<size_t, 3> colourEnd{};
+
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> angle;
+    std::vector<float> angularVelocity;
+    std::vector<float> sinAngle;
+    std::vector<float> cosAngle;
+    std::vector<uint32_t> instanceSlot;
+    std::array<std::vector<uint32_t>, 6> neighbours;
+
+    // Per neighbour direction, dE/dtheta_i gains cos(theta_i) sin(theta_j) coefficientSin and
+    // loses sin(theta_i) cos(theta_j) coefficientCos.
+    std::array<float, 6> coefficientSin{};
+    std::array<float, 6> coefficientCos{};
+    float fieldY = 0.0f;
+    float fieldZ = 0.0f;
+
+    double simulatedSeconds = 0.0;
+    uint64_t stepCount = 0;
+    uint64_t solveNs = 0;
+
+    // With m = (0, -sin t, cos t) and r in the lattice plane, the dipole term of magnets.comp
+    // reduces to c / r^3 [sin(t_j - t_i) - 3 r_y^2 cos t_i sin t_j].
+    void setDirection(size_t d, glm::vec2 r) {
+      float distance = glm::length(r);
+      float ry = r.y / distance;
+      float scale = config.coupling / (distance * distance * distance);
+      coefficientSin[d] = scale * (1.0f - 3.0f * ry * ry);
+      coefficientCos[d] = scale;
+    }
+
+    std::pair<size_t, size_t> chunk(size_t begin, size_t end, uint32_t worker) const {
+      size_t threads = pool.getThreadCount();
+      size_t perThread = (end - begin + threads - 1) / threads;
+      perThread = (perThread + CHUNK_ALIGNMENT - 1) / CHUNK_ALIGNMENT * CHUNK_ALIGNMENT;
+      size_t first = std::min(end, begin + perThread * worker);
+      return {first, std::min(end, first + perThread)};
+    }
+
+    void updateRange(size_t begin, size_t end) {
+      if (simd) {
+        updateRangeSimd(begin, end);
+      } else {
+        updateRangeWith<ScalarFloat>(begin, end);
+      }
+    }
+
+#if defined(VULKAN_MAGNETS_AVX2_KERNEL)
+    AVX2_TARGET
+#endif
+    void updateRangeSimd(size_t begin, size_t end) {
+      updateRangeWith<SimdFloat>(begin, end);
+    }
+
+    template<typename V>
+    KERNEL_INLINE void updateRangeWith(size_t begin, size_t end) {
+      size_t i = begin;
+      for (; i + V::WIDTH <= end; i += V::WIDTH) {
+        updateMagnets<V>(i);
+      }
+      for (; i < end; i++) {
+        updateMagnets<ScalarFloat>(i);
+      }
+    }
+
+    template<typename V>
+    KERNEL_INLINE void updateMagnets(size_t i) {
+      V sinSum = V::set(0.0f);
+      V cosSum = V::set(0.0f);
+      for (size_t d = 0; d < neighbours.size(); d++) {
+        const uint32_t *indices = neighbours[d].data() + i;
+        sinSum = sinSum + V::set(coefficientSin[d]) * V::gather(sinAngle.data(), indices);
+        cosSum = cosSum + V::set(coefficientCos[d]) * V::gather(cosAngle.data(), indices);
+      }
+
+      V s = V::load(sinAngle.data() + i);
+      V c = V::load(cosAngle.data() + i);
+      V dEnergy = c * sinSum - s * cosSum + V::set(fieldY) * c + V::set(fieldZ) * s;
+
+      V dt = V::set(config.timeStep);
+      V velocity = V::load(angularVelocity.data() + i);
+      velocity = velocity
+                 - dt * (dEnergy * V::set(1.0f / config.inertia) + V::set(config.damping) * velocity);
+      V theta = V::load(angle.data() + i) + dt * velocity;
+
+      constexpr float twoPi = 6.28318531f;
+      theta = theta - V::set(twoPi) * floor((theta + V::set(0.5f * twoPi)) * V::set(1.0f / twoPi));
+
+      velocity.store(angularVelocity.data() + i);
+      theta.store(angle.data() + i);
+      sinCos(theta, s, c);
+      s.store(sinAngle.data() + i);
+      c.store(cosAngle.data() + i);
+    }
+
+    // theta in [-pi, pi): theta = k pi + r with k in {-1, 0, 1} and |r| <= pi / 2, so both series
+    // converge to float precision and the sign flips for odd k.
+    template<typename V>
+    KERNEL_INLINE static void sinCos(const V &theta, V &s, V &c) {
+      V k = floor(theta * V::set(1.0f / glm::pi<float>()) + V::set(0.5f));
+      V r = theta - k * V::set(glm::pi<float>());
+      V sign = V::set(1.0f) - V::set(2.0f) * k * k;
+      V r2 = r * r;
+
+      V sinPoly = V::set(-2.5052108e-8f);
+      sinPoly = sinPoly * r2 + V::set(2.7557319e-6f);
+      sinPoly = sinPoly * r2 + V::set(-1.9841270e-4f);
+      sinPoly = sinPoly * r2 + V::set(8.3333333e-3f);
+      sinPoly = sinPoly * r2 + V::set(-1.6666667e-1f);
+      s = sign * (r + r * r2 * sinPoly);
+
+      V cosPoly = V::set(2.0876757e-9f);
+      cosPoly = cosPoly * r2 + V::set(-2.7557319e-7f);
+      cosPoly = cosPoly * r2 + V::set(2.4801587e-5f);
+      cosPoly = cosPoly * r2 + V::set(-1.3888889e-3f);
+      cosPoly = cosPoly * r2 + V::set(4.1666667e-2f);
+      cosPoly = cosPoly * r2 + V::set(-0.5f);
+      c = sign * (V::set(1.0f) + r2 * cosPoly);
+    }
+};
@@ -0,0 +1,109 @@
+//
+// Created by Elijah Crain on 10/17/26.
+//
+#pragma once
+
+#include "Util.cpp"
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+// Half-open range of instance indices.
+struct InstanceRange {
+  size_t begin = 0;
+  size_t end = 0;
+};
+
+// CPU copy of one instance buffer that remembers what changed. Every frame slot keeps its own
+// list of dirty ranges, since each slot has its own GPU copy that only catches up when that slot
+// is recorded again. Ranges are coalesced when taken, merging neighbours whose gap is small
+// enough that copying it is cheaper than another copy region.
+class InstanceStore {
+  public:
+    // Gaps up to this many instances are copied along rather than split into two regions.
+    static constexpr size_t MERGE_GAP = 4;
+    // Past this many pending ranges a slot's list is coalesced in place to bound its memory.
+    static constexpr size_t MAX_PENDING_RANGES = 65536;
+
+    explicit InstanceStore(uint32_t slotCount = 1) : pending(slotCount) {}
+
+    // Replaces the contents. The caller uploads them in full, so nothing is left dirty.
+    void assign(std::vector<InstanceData> newInstances) {
+      instances = std::move(newInstances);
+      clearDirty();
+    }
+
+    void set(size_t index, const InstanceData &instance) {
+      if (index >= instances.size()) {
+        throw std::out_of_range("instance index out of range!");
+      }
+      instances[index] = instance;
+      markDirty(index, index + 1);
+    }
+
+    void markDirty(size_t begin, size_t end) {
+      end = std::min(end, instances.size());
+      if (begin >= end) {
+        return;
+      }
+      for (auto &ranges : pending) {
+        // Consecutive edits usually extend the last range.
+        if (!ranges.empty() && begin <= ranges.back().end + MERGE_GAP && end + MERGE_GAP >= ranges.back().begin) {
+          ranges.back().begin = std::min(ranges.back().begin, begin);
+          ranges.back().end = std::max(ranges.back().end, end);
+          continue;
+        }
+        ranges.push_back({begin, end});
+        if (ranges.size() > MAX_PENDING_RANGES) {
+          coalesce(ranges);
+        }
+      }
+    }
+
+    void clearDirty() {
+      for (auto &ranges : pending) {
+        ranges.clear();
+      }
+    }
+
+    // Coalesced ranges changed since `slot` last took them, sorted by begin.
+    std::vector<InstanceRange> takeDirty(uint32_t slot) {
+      std::vector<InstanceRange> ranges = std::move(pending[slot]);
+      pending[slot].clear();
+      coalesce(ranges);
+      return ranges;
+    }
+
+    [[nodiscard]] size_t size() const { return instances.size(); }
+    [[nodiscard]] bool empty() const { return instances.empty(); }
+    [[nodiscard]] const InstanceData *data() const { return instances.data(); }
+    [[nodiscard]] const InstanceData &operator[](size_t index) const { return instances[index]; }
+    [[nodiscard]] const std::vector<InstanceData> &values() const { return instances; }
+
+  private:
+    std::vector<InstanceData> instances;
+    std::vector<std::vector<InstanceRange>> pending;
+
+    static void coalesce(std::vector<InstanceRange> &ranges) {
+      if (ranges.size() < 2) {
+        return;
+      }
+      std::sort(ranges.begin(), ranges.end(), [](const InstanceRange &a, const InstanceRange &b) {
+        return a.begin < b.begin;
+      });
+      size_t out = 0;
+      for (size_t i = 1; i < ranges.size(); i++) {
+        if (ranges[i].begin <= ranges[out].end + MERGE_GAP) {
+          ranges[out].end = std::max(ranges[out].end, ranges[i].end);
+        } else {
+          ranges[++out] = ranges[i];
+        }
+      }
+      ranges.resize(out + 1);
+      // Still too scattered: one range over all of it beats an unbounded list.
+      if (ranges.size() > MAX_PENDING_RANGES) {
+        ranges = {{ranges.front().begin, ranges.back().end}};
+      }
+    }
+};
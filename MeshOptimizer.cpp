@@ -0,0 +1,242 @@
+//
+// Created by Elijah Crain on 10/17/26.
+//
+#pragma once
+
+#include "Util.cpp"
+#include <vector>
+#include <array>
+#include <map>
+#include <deque>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// Post-transform cache figures of an indexed triangle list, measured on a FIFO cache of
+// MESH_CACHE_SIZE entries, which is roughly how GPUs reuse vertex shader results.
+// ACMR is vertex shader runs per triangle (0.5 is the ideal for a regular mesh, 3 means no
+// reuse); ATVR is runs per unique vertex, 1 being the ideal.
+struct MeshStats {
+  uint32_t vertexCount = 0;
+  uint32_t triangleCount = 0;
+  uint32_t transformedVertices = 0;
+  float acmr = 0.0f;
+  float atvr = 0.0f;
+};
+
+struct MeshOptimizationReport {
+  MeshStats before;
+  MeshStats after;
+};
+
+constexpr uint32_t MESH_CACHE_SIZE = 16;
+
+inline MeshStats analyzeMesh(const std::vector<uint32_t> &indices, uint32_t vertexCount,
+                             uint32_t cacheSize = MESH_CACHE_SIZE) {
+  MeshStats stats;
+  stats.vertexCount = vertexCount;
+  stats.triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+  std::deque<uint32_t> cache;
+  std::vector<bool> referenced(vertexCount, false);
+  uint32_t referencedCount = 0;
+  for (uint32_t index : indices) {
+    if (!referenced[index]) {
+      referenced[index] = true;
+      referencedCount++;
+    }
+    if (std::find(cache.begin(), cache.end(), index) != cache.end()) {
+      continue;
+    }
+    stats.transformedVertices++;
+    cache.push_back(index);
+    if (cache.size() > cacheSize) {
+      cache.pop_front();
+    }
+  }
+  if (stats.triangleCount > 0) {
+    stats.acmr = static_cast<float>(stats.transformedVertices) / static_cast<float>(stats.triangleCount);
+  }
+  if (referencedCount > 0) {
+    stats.atvr = static_cast<float>(stats.transformedVertices) / static_cast<float>(referencedCount);
+  }
+  return stats;
+}
+
+// Merges vertices with identical position and colour, rewriting the indices to the survivor.
+inline void weldVertices(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+  std::map<std::array<float, 6>, uint32_t> unique;
+  std::vector<uint32_t> remap(vertices.size());
+  std::vector<Vertex> welded;
+  for (size_t i = 0; i < vertices.size(); i++) {
+    const Vertex &vertex = vertices[i];
+    std::array<float, 6> key = {vertex.pos.x, vertex.pos.y, vertex.pos.z,
+                                vertex.color.x, vertex.color.y, vertex.color.z};
+    auto [it, inserted] = unique.emplace(key, static_cast<uint32_t>(welded.size()));
+    if (inserted) {
+      welded.push_back(vertex);
+    }
+    remap[i] = it->second;
+  }
+  for (uint32_t &index : indices) {
+    index = remap[index];
+  }
+  vertices = std::move(welded);
+}
+
+// Reorders triangles for post-transform cache reuse with Forsyth's linear-speed algorithm:
+// greedily emits the triangle whose vertices score highest, where a vertex scores for sitting
+// near the front of a simulated LRU cache and for having few triangles left, so fans get
+// finished instead of leaving stragglers to transform again later.
+inline void optimizeVertexCache(std::vector<uint32_t> &indices, uint32_t vertexCount) {
+  constexpr uint32_t CACHE_SIZE = 32;
+  constexpr float CACHE_DECAY_POWER = 1.5f;
+  constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+  constexpr float VALENCE_BOOST_SCALE = 2.0f;
+  constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+  const auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // Triangles using each vertex, as ranges of vertexTriangles; the live ones come first.
+  std::vector<uint32_t> remaining(vertexCount, 0);
+  for (uint32_t index : indices) {
+    remaining[index]++;
+  }
+  std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+  }
+  std::vector<uint32_t> vertexTriangles(indices.size());
+  std::vector<uint32_t> filled(vertexCount, 0);
+  for (uint32_t t = 0; t < triangleCount; t++) {
+    for (uint32_t k = 0; k < 3; k++) {
+      uint32_t v = indices[3 * t + k];
+      vertexTriangles[firstTriangle[v] + filled[v]++] = t;
+    }
+  }
+
+  std::vector<int32_t> cachePosition(vertexCount, -1);
+  auto vertexScore = [&](uint32_t v) {
+    if (remaining[v] == 0) {
+      return -1.0f;
+    }
+    float score = 0.0f;
+    int32_t position = cachePosition[v];
+    if (position >= 0) {
+      if (position < 3) {
+        score = LAST_TRIANGLE_SCORE;
+      } else {
+        float scale = 1.0f / static_cast<float>(CACHE_SIZE - 3);
+        score = std::pow(1.0f - static_cast<float>(position - 3) * scale, CACHE_DECAY_POWER);
+      }
+    }
+    return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remaining[v]), -VALENCE_BOOST_POWER);
+  };
+
+  std::vector<float> scores(vertexCount);
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    scores[v] = vertexScore(v);
+  }
+  std::vector<float> triangleScores(triangleCount);
+  std::vector<bool> emitted(triangleCount, false);
+  for (uint32_t t = 0; t < triangleCount; t++) {
+    triangleScores[t] = scores[indices[3 * t]] + scores[indices[3 * t + 1]] + scores[indices[3 * t + 2]];
+  }
+
+  auto bestRemaining = [&]() {
+    uint32_t best = triangleCount;
+    for (uint32_t t = 0; t < triangleCount; t++) {
+      if (!emitted[t] && (best == triangleCount || triangleScores[t] > triangleScores[best])) {
+        best = t;
+      }
+    }
+    return best;
+  };
+
+  std::vector<uint32_t> ordered;
+  ordered.reserve(indices.size());
+  std::vector<uint32_t> cache;
+  uint32_t next = bestRemaining();
+  while (next != triangleCount) {
+    emitted[next] = true;
+    const std::array<uint32_t, 3> corners = {indices[3 * next], indices[3 * next + 1], indices[3 * next + 2]};
+    for (uint32_t v : corners) {
+      ordered.push_back(v);
+      // Retire the triangle from v's live range.
+      uint32_t *begin = vertexTriangles.data() + firstTriangle[v];
+      uint32_t *end = begin + remaining[v];
+      std::iter_swap(std::find(begin, end, next), end - 1);
+      remaining[v]--;
+    }
+
+    // The triangle's vertices move to the front; whatever falls off the end leaves the cache.
+    std::vector<uint32_t> updated(corners.begin(), corners.end());
+    for (uint32_t v : cache) {
+      if (std::find(corners.begin(), corners.end(), v) == corners.end()) {
+        updated.push_back(v);
+      }
+    }
+    for (size_t i = 0; i < updated.size(); i++) {
+      cachePosition[updated[i]] = i < CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+    }
+
+    // Rescore everything that was or is cached, and the live triangles around it.
+    float bestScore = -1.0f;
+    next = triangleCount;
+    for (uint32_t v : updated) {
+      scores[v] = vertexScore(v);
+    }
+    for (uint32_t v : updated) {
+      for (uint32_t i = 0; i < remaining[v]; i++) {
+        uint32_t t = vertexTriangles[firstTriangle[v] + i];
+        triangleScores[t] = scores[indices[3 * t]] + scores[indices[3 * t + 1]] + scores[indices[3 * t + 2]];
+        if (triangleScores[t] > bestScore) {
+          bestScore = triangleScores[t];
+          next = t;
+        }
+      }
+    }
+    if (updated.size() > CACHE_SIZE) {
+      updated.resize(CACHE_SIZE);
+    }
+    cache = std::move(updated);
+
+    if (next == triangleCount) {
+      next = bestRemaining();
+    }
+  }
+  indices = std::move(ordered);
+}
+
+// Renumbers vertices in order of first use so the vertex fetch walks the buffer forwards;
+// vertices no triangle uses are dropped.
+inline void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+  constexpr uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> remap(vertices.size(), UNUSED);
+  std::vector<Vertex> ordered;
+  ordered.reserve(vertices.size());
+  for (uint32_t &index : indices) {
+    if (remap[index] == UNUSED) {
+      remap[index] = static_cast<uint32_t>(ordered.size());
+      ordered.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+  vertices = std::move(ordered);
+}
+
+// Welds, reorders for the post-transform cache, then for fetch locality. The image is
+// unchanged: triangles keep their winding and only exact duplicate vertices are merged.
+inline MeshOptimizationReport optimizeMesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+  MeshOptimizationReport report;
+  report.before = analyzeMesh(indices, static_cast<uint32_t>(vertices.size()));
+  weldVertices(vertices, indices);
+  optimizeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+  optimizeVertexFetch(vertices, indices);
+  report.after = analyzeMesh(indices, static_cast<uint32_t>(vertices.size()));
+  return report;
+}
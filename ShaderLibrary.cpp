@@ -0,0 +1,298 @@
+//
+// Created by Elijah Crain on 10/17/26.
+//
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+#include <iostream>
+
+enum class ShaderId : uint32_t {
+  Vertex,
+  Fragment,
+  Cull,
+  Magnets,
+  // shader.vert built with -DCAMERA_IN_UNIFORM, for command buffers that are replayed.
+  VertexCameraUniform,
+  Count
+};
+
+using SpirvCode = std::vector<uint32_t>;
+
+// The build compiles shaders/ with `glslc -mfmt=c`, which writes each module as a C initializer
+// list of SPIR-V words, and puts the results on the include path. Builds without them (no
+// glslc at configure time) fall back to the .spv files from shaders/compile.sh.
+#if __has_include("shader.vert.inc") && __has_include("shader.frag.inc") \
+  && __has_include("cull.comp.inc") && __has_include("magnets.comp.inc") \
+  && __has_include("shader.vert.camera.inc")
+#define VULKAN_MAGNETS_EMBEDDED_SHADERS 1
+namespace EmbeddedShaders {
+  inline constexpr uint32_t vertex[] =
+#include "shader.vert.inc"
+  ;
+  inline constexpr uint32_t fragment[] =
+#include "shader.frag.inc"
+  ;
+  inline constexpr uint32_t cull[] =
+#include "cull.comp.inc"
+  ;
+  inline constexpr uint32_t magnets[] =
+#include "magnets.comp.inc"
+  ;
+  inline constexpr uint32_t vertexCameraUniform[] =
+#include "shader.vert.camera.inc"
+  ;
+}
+#endif
+
+#ifndef VULKAN_MAGNETS_SHADER_DIR
+#define VULKAN_MAGNETS_SHADER_DIR "../shaders"
+#endif
+#ifndef VULKAN_MAGNETS_GLSLC
+#define VULKAN_MAGNETS_GLSLC "glslc"
+#endif
+
+// Current SPIR-V of every shader. Starts from the code embedded at build time; with watching
+// enabled, a background thread polls the GLSL sources, recompiles any that change and hands the
+// result to the render thread through takeReloaded(), so a broken edit only prints glslc's
+// errors and the running pipelines stay as they are.
+class ShaderLibrary {
+  public:
+    ShaderLibrary() {
+      for (uint32_t i = 0; i < SHADER_COUNT; i++) {
+        code[i] = loadInitial(static_cast<ShaderId>(i));
+      }
+    }
+
+    ~ShaderLibrary() {
+      stopWatching();
+    }
+
+    ShaderLibrary(const ShaderLibrary &) = delete;
+    ShaderLibrary &operator=(const ShaderLibrary &) = delete;
+
+    [[nodiscard]] const SpirvCode &get(ShaderId id) const { return code[static_cast<uint32_t>(id)]; }
+
+    // Development mode: recompile shaders whose source in `sourceDir` changes.
+    void startWatching(std::string sourceDir = VULKAN_MAGNETS_SHADER_DIR,
+                       std::string compiler = VULKAN_MAGNETS_GLSLC,
+                       std::chrono::milliseconds pollInterval = std::chrono::milliseconds(250)) {
+      stopWatching();
+      this->sourceDir = std::move(sourceDir);
+      this->compiler = std::move(compiler);
+      stopRequested = false;
+      for (uint32_t i = 0; i < SHADER_COUNT; i++) {
+        lastWrite[i] = sourceTime(static_cast<ShaderId>(i));
+      }
+      watcher = std::thread([this, pollInterval]() { watch(pollInterval); });
+    }
+
+    void stopWatching() {
+      if (!watcher.joinable()) {
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+      }
+      wake.notify_all();
+      watcher.join();
+    }
+
+    [[nodiscard]] bool isWatching() const { return watcher.joinable(); }
+
+    // Installs every shader recompiled since the last call and returns which ones changed.
+    // Render thread only.
+    std::vector<ShaderId> takeReloaded() {
+      std::vector<ShaderId> reloaded;
+      std::lock_guard<std::mutex> lock(mutex);
+      for (uint32_t i = 0; i < SHADER_COUNT; i++) {
+        if (pending[i]) {
+          code[i] = std::move(*pending[i]);
+          pending[i].reset();
+          reloaded.push_back(static_cast<ShaderId>(i));
+        }
+      }
+      return reloaded;
+    }
+
+    static const char *sourceName(ShaderId id) {
+      switch (id) {
+        case ShaderId::Vertex: return "shader.vert";
+        case ShaderId::Fragment: return "shader.frag";
+        case ShaderId::Cull: return "cull.comp";
+        case ShaderId::VertexCameraUniform: return "shader.vert";
+        default: return "magnets.comp";
+      }
+    }
+
+    // Extra glslc arguments of the variants compiled from a shared source.
+    static const char *defines(ShaderId id) {
+      return id == ShaderId::VertexCameraUniform ? "-DCAMERA_IN_UNIFORM" : "";
+    }
+
+  private:
+    static constexpr uint32_t SHADER_COUNT = static_cast<uint32_t>(ShaderId::Count);
+
+    std::array<SpirvCode, SHADER_COUNT> code;
+
+    std::string sourceDir;
+    std::string compiler;
+    std::array<std::filesystem::file_time_type, SHADER_COUNT> lastWrite{};
+    std::thread watcher;
+    // Guards pending and stopRequested.
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::array<std::optional<SpirvCode>, SHADER_COUNT> pending;
+    bool stopRequested = false;
+
+    static SpirvCode loadInitial(ShaderId id) {
+#ifdef VULKAN_MAGNETS_EMBEDDED_SHADERS
+      auto words = [](const auto &array) { return SpirvCode(std::begin(array), std::end(array)); };
+      switch (id) {
+        case ShaderId::Vertex: return words(EmbeddedShaders::vertex);
+        case ShaderId::Fragment: return words(EmbeddedShaders::fragment);
+        case ShaderId::Cull: return words(EmbeddedShaders::cull);
+        case ShaderId::VertexCameraUniform: return words(EmbeddedShaders::vertexCameraUniform);
+        default: return words(EmbeddedShaders::magnets);
+      }
+#else
+      static constexpr const char *COMPILED[] = {"vert.spv", "frag.spv", "cull.spv", "magnets.spv", "vert_camera.spv"};
+      return readSpirv(std::string(VULKAN_MAGNETS_SHADER_DIR) + "/" + COMPILED[static_cast<uint32_t>(id)]);
+#endif
+    }
+
+    static SpirvCode readSpirv(const std::string &path) {
+      std::ifstream file(path, std::ios::ate | std::ios::binary);
+      if (!file.is_open()) {
+        throw std::runtime_error("failed to open shader " + path + "!");
+      }
+      auto size = static_cast<size_t>(file.tellg());
+      if (size == 0 || size % sizeof(uint32_t) != 0) {
+        throw std::runtime_error("shader " + path + " is not SPIR-V!");
+      }
+      SpirvCode words(size / sizeof(uint32_t));
+      file.seekg(0);
+      file.read(reinterpret_cast<char *>(words.data()), static_cast<std::streamsize>(size));
+      return words;
+    }
+
+    std::filesystem::path sourcePath(ShaderId id) const {
+      return std::filesystem::path(sourceDir) / sourceName(id);
+    }
+
+    std::filesystem::file_time_type sourceTime(ShaderId id) const {
+      std::error_code error;
+      auto time = std::filesystem::last_write_time(sourcePath(id), error);
+      return error ? std::filesystem::file_time_type{} : time;
+    }
+
+    void watch(std::chrono::milliseconds pollInterval) {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (!wake.wait_for(lock, pollInterval, [this]() { return stopRequested; })) {
+        lock.unlock();
+        for (uint32_t i = 0; i < SHADER_COUNT; i++) {
+          auto id = static_cast<ShaderId>(i);
+          auto time = sourceTime(id);
+          if (time == lastWrite[i]) {
+            continue;
+          }
+          lastWrite[i] = time;
+          if (std::optional<SpirvCode> compiled = compile(id)) {
+            std::lock_guard<std::mutex> pendingLock(mutex);
+            pending[i] = std::move(compiled);
+          }
+        }
+        lock.lock();
+      }
+    }
+
+    // Runs glslc on the source; glslc reports its own errors on stderr.
+    std::optional<SpirvCode> compile(ShaderId id) const {
+      std::filesystem::path output = std::filesystem::temp_directory_path()
+                                     / ("vulkan_magnets_" + std::to_string(static_cast<uint32_t>(id)) + ".spv");
+      std::string command = "\"" + compiler + "\" " + defines(id) + " \"" + sourcePath(id).string() + "\" -o \""
+                            + output.string() + "\"";
+      if (std::system(command.c_str()) != 0) {
+        std::cerr << "shader reload: " << sourceName(id) << " failed to compile, keeping the old code" << std::endl;
+        return std::nullopt;
+      }
+      try {
+        SpirvCode words = readSpirv(output.string());
+        std::cerr << "shader reload: recompiled " << sourceName(id) << std::endl;
+        return words;
+      } catch (const std::exception &e) {
+        std::cerr << "shader reload: " << e.what() << std::endl;
+        return std::nullopt;
+      }
+    }
+};
+
+// Compute pipelines here are one shader and a layout; shared by the cull and magnet passes.
+inline VkPipeline createComputePipeline(VkDevice device,
+                                        VkPipelineCache pipelineCache,
+                                        VkPipelineLayout layout,
+                                        const SpirvCode &code,
+                                        const VkSpecializationInfo *specialization = nullptr) {
+  VkShaderModuleCreateInfo moduleInfo{};
+  moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  moduleInfo.codeSize = code.size() * sizeof(uint32_t);
+  moduleInfo.pCode = code.data();
+
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(device, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create shader module!");
+  }
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shaderModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.stage.pSpecializationInfo = specialization;
+  pipelineInfo.layout = layout;
+
+  VkPipeline pipeline;
+  VkResult result = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+  vkDestroyShaderModule(device, shaderModule, nullptr);
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to create compute pipeline!");
+  }
+  return pipeline;
+}
+
+// Records a dispatch of `items` invocations, `groupSize` to a workgroup. Past
+// maxComputeWorkGroupCount[0] workgroups, which may be as low as 65535, the groups wrap into
+// rows along y, so the shader's item index is
+// gl_GlobalInvocationID.y * gl_NumWorkGroups.x * gl_WorkGroupSize.x + gl_GlobalInvocationID.x,
+// and the last row may run past `items`.
+inline void dispatchItems(VkCommandBuffer commandBuffer,
+                          uint32_t items,
+                          uint32_t groupSize,
+                          const std::array<uint32_t, 3> &maxWorkGroupCount) {
+  if (items == 0) {
+    return;
+  }
+  const uint32_t groups = static_cast<uint32_t>((static_cast<uint64_t>(items) + groupSize - 1) / groupSize);
+  const uint32_t columns = std::min(groups, maxWorkGroupCount[0]);
+  const uint32_t rows = (groups + columns - 1) / columns;
+  if (rows > maxWorkGroupCount[1]) {
+    throw std::runtime_error("too many workgroups for one dispatch!");
+  }
+  vkCmdDispatch(commandBuffer, columns, rows, 1);
+}
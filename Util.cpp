@@ -4,55 +4,204 @@
 #pragma once
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/packing.hpp>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <array>
 
+// Matches the Magnet struct in magnets.comp and cull.comp, which read and write it as std430.
 struct InstanceData {
   glm::vec2 offset;
+  float angle = 0.0f;            // rotation about the hex's x axis, radians
+  float angularVelocity = 0.0f;
 };
 
+// Physical constants of the magnet lattice, in lattice units: coupling is the dipole energy of
+// two aligned neighbours, the drive field rotates in the y-z plane at fieldFrequency cycles per
+// simulated second.
+struct MagnetSimulationConfig {
+  float coupling = 1.0f;
+  float damping = 0.8f;
+  float inertia = 0.05f;
+  float fieldStrength = 1.5f;
+  float fieldFrequency = 0.2f;
+  float timeStep = 1.0f / 240.0f;
+  uint32_t stepsPerFrame = 1;
+};
+
+// One mesh inside a merged vertex and index buffer, in the terms of VkDrawIndexedIndirectCommand.
+struct MeshRange {
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+  int32_t vertexOffset = 0;
+};
+
+// Index data packed to the narrowest index type that addresses every vertex it references.
+struct PackedIndices {
+  std::vector<uint8_t> bytes;
+  VkIndexType type = VK_INDEX_TYPE_UINT16;
+  uint32_t count = 0;
+
+  static PackedIndices pack(const std::vector<uint32_t> &indices) {
+    PackedIndices packed;
+    packed.count = static_cast<uint32_t>(indices.size());
+    uint32_t maxIndex = indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end());
+
+    if (maxIndex <= UINT16_MAX) {
+      packed.type = VK_INDEX_TYPE_UINT16;
+      packed.bytes.resize(indices.size() * sizeof(uint16_t));
+      auto *out = reinterpret_cast<uint16_t *>(packed.bytes.data());
+      for (size_t i = 0; i < indices.size(); i++) {
+        out[i] = static_cast<uint16_t>(indices[i]);
+      }
+    } else {
+      packed.type = VK_INDEX_TYPE_UINT32;
+      packed.bytes.resize(indices.size() * sizeof(uint32_t));
+      memcpy(packed.bytes.data(), indices.data(), packed.bytes.size());
+    }
+    return packed;
+  }
+};
+
+// Layout of the vertex and instance streams the hexes are drawn from. Full keeps every
+// attribute as 32-bit floats; Compact stores vertex positions and instance angles as half
+// floats and colours as RGBA8, halving the bytes fetched per vertex. The CPU side always works
+// in Vertex and InstanceData and converts on upload.
+enum class VertexFormat {
+  Full,
+  Compact
+};
+
+inline const char *vertexFormatName(VertexFormat format) {
+  return format == VertexFormat::Compact ? "compact" : "full";
+}
+
+struct Vertex;
+
+// Compact Vertex: xyz as half floats (w unused), colour as RGBA8 UNORM. 12 bytes instead of 24.
+struct CompactVertex {
+  std::array<uint16_t, 4> pos{};
+  uint32_t color = 0;
+
+  CompactVertex() = default;
+  explicit CompactVertex(const Vertex &vertex);
+};
+static_assert(sizeof(CompactVertex) == 12);
+
+// Compact InstanceData: the offset stays full precision, since it grows with the lattice, and
+// the angle, bounded to [-pi, pi), is a half float. The angular velocity is simulation state the
+// draws never read, so it is dropped. 12 bytes instead of 16; matches the 3-word records of
+// cull.comp and magnets.comp.
+struct CompactInstance {
+  glm::vec2 offset{};
+  uint16_t angle = 0;
+  uint16_t unused = 0;
+
+  CompactInstance() = default;
+  explicit CompactInstance(const InstanceData &instance)
+    : offset(instance.offset), angle(static_cast<uint16_t>(glm::packHalf1x16(instance.angle))) {}
+};
+static_assert(sizeof(CompactInstance) == 12);
+
+inline uint32_t instanceStride(VertexFormat format) {
+  return format == VertexFormat::Compact ? sizeof(CompactInstance) : sizeof(InstanceData);
+}
+
+// Specializes the compute shaders that read or write drawn instances to the layout: constant 0
+// is the record size in 32-bit words. Pass `info` when creating the pipeline.
+struct InstanceLayoutSpecialization {
+  uint32_t instanceWords;
+  VkSpecializationMapEntry entry{0, 0, sizeof(uint32_t)};
+  VkSpecializationInfo info{};
+
+  explicit InstanceLayoutSpecialization(VertexFormat format) : instanceWords(instanceStride(format) / 4) {
+    info.mapEntryCount = 1;
+    info.pMapEntries = &entry;
+    info.dataSize = sizeof(instanceWords);
+    info.pData = &instanceWords;
+  }
+  // info points into the object itself.
+  InstanceLayoutSpecialization(const InstanceLayoutSpecialization &) = delete;
+  InstanceLayoutSpecialization &operator=(const InstanceLayoutSpecialization &) = delete;
+};
+
+// Writes `count` instances to `out` in the layout `format` draws them with.
+inline void encodeInstances(VertexFormat format, const InstanceData *instances, size_t count, void *out) {
+  if (format == VertexFormat::Full) {
+    memcpy(out, instances, sizeof(InstanceData) * count);
+    return;
+  }
+  auto *compact = static_cast<CompactInstance *>(out);
+  for (size_t i = 0; i < count; i++) {
+    compact[i] = CompactInstance(instances[i]);
+  }
+}
+
 struct Vertex {
   glm::vec3 pos;
   glm::vec3 color;
 
-  static VkVertexInputBindingDescription getBindingDescription() {
+  static uint32_t stride(VertexFormat format) {
+    return format == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+  }
+
+  static VkVertexInputBindingDescription getBindingDescription(VertexFormat format) {
     VkVertexInputBindingDescription bindingDescription{};
     bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof(Vertex);
+    bindingDescription.stride = stride(format);
     bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
     return bindingDescription;
   }
 
-  // In Vertex struct
-  static VkVertexInputBindingDescription getInstanceBindingDescription() {
+  static VkVertexInputBindingDescription getInstanceBindingDescription(VertexFormat format) {
     VkVertexInputBindingDescription bindingDescription{};
     bindingDescription.binding = 1; // Binding 1 for instance data
-    bindingDescription.stride = sizeof(InstanceData);
+    bindingDescription.stride = instanceStride(format);
     bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
     return bindingDescription;
   }
 
-
-  static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
-    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+  // The shader reads the same vec3 / float inputs either way; the formats do the widening.
+  static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions(VertexFormat format) {
+    const bool compact = format == VertexFormat::Compact;
+    std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
 
     // Position attribute
     attributeDescriptions[0].binding = 0;
     attributeDescriptions[0].location = 0;
-    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[0].offset = offsetof(Vertex, pos);
+    attributeDescriptions[0].format = compact ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[0].offset = compact ? offsetof(CompactVertex, pos) : offsetof(Vertex, pos);
 
     // Color attribute
     attributeDescriptions[1].binding = 0;
     attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[1].offset = offsetof(Vertex, color);
+    attributeDescriptions[1].format = compact ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[1].offset = compact ? offsetof(CompactVertex, color) : offsetof(Vertex, color);
 
     // Instance offset attribute
     attributeDescriptions[2].binding = 1;
     attributeDescriptions[2].location = 2;
     attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    attributeDescriptions[2].offset = offsetof(InstanceData, offset);
+    attributeDescriptions[2].offset = compact ? offsetof(CompactInstance, offset) : offsetof(InstanceData, offset);
+
+    // Instance rotation attribute
+    attributeDescriptions[3].binding = 1;
+    attributeDescriptions[3].location = 3;
+    attributeDescriptions[3].format = compact ? VK_FORMAT_R16_SFLOAT : VK_FORMAT_R32_SFLOAT;
+    attributeDescriptions[3].offset = compact ? offsetof(CompactInstance, angle) : offsetof(InstanceData, angle);
 
     return attributeDescriptions;
   }
 
-};
\ No newline at end of file
+};
+
+inline CompactVertex::CompactVertex(const Vertex &vertex) {
+  pos = {static_cast<uint16_t>(glm::packHalf1x16(vertex.pos.x)),
+         static_cast<uint16_t>(glm::packHalf1x16(vertex.pos.y)),
+         static_cast<uint16_t>(glm::packHalf1x16(vertex.pos.z)),
+         0};
+  color = glm::packUnorm4x8(glm::vec4(vertex.color, 1.0f));
+}
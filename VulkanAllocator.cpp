@@ -0,0 +1,351 @@
+//
+// Created by Elijah Crain on 10/17/26.
+//
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+
+struct GpuMemoryBlock;
+
+// A range of device memory handed out by VulkanAllocator. `memory` and `offset` are what
+// vkBind*Memory takes; `mapped` already points at `offset` for HOST_VISIBLE memory.
+struct GpuAllocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  void *mapped = nullptr;
+  uint32_t memoryType = 0;
+  GpuMemoryBlock *block = nullptr;  // null for dedicated allocations
+};
+
+struct GpuMemoryStats {
+  uint32_t blockCount = 0;
+  uint32_t dedicatedCount = 0;
+  uint32_t allocationCount = 0;     // live sub-allocations plus dedicated allocations
+  VkDeviceSize reservedBytes = 0;   // device memory held in blocks and dedicated allocations
+  VkDeviceSize usedBytes = 0;       // bytes handed out of that
+  uint64_t vkAllocateCalls = 0;     // lifetime count of vkAllocateMemory calls
+};
+
+struct GpuMemoryBlock {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize size = 0;
+  uint8_t *mapped = nullptr;
+  uint32_t pool = 0;
+  uint32_t allocationCount = 0;
+  VkDeviceSize usedBytes = 0;
+  std::map<VkDeviceSize, VkDeviceSize> freeRanges;  // offset -> size, coalesced on free
+};
+
+// Block allocator: one pool of large VkDeviceMemory blocks per memory type, sub-allocated
+// first-fit from a coalescing free list. Buffers and optimally tiled images get separate
+// pools when bufferImageGranularity > 1, so neighbours in a block never need the granularity
+// padding. Requests the driver prefers dedicated, or that would take more than half a block,
+// get their own vkAllocateMemory.
+class VulkanAllocator {
+  public:
+    enum class ResourceKind : uint32_t { Linear = 0, Optimal = 1 };
+
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+    VulkanAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize preferredBlockSize = DEFAULT_BLOCK_SIZE)
+      : device(device), preferredBlockSize(preferredBlockSize) {
+      vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+      VkPhysicalDeviceProperties props;
+      vkGetPhysicalDeviceProperties(physicalDevice, &props);
+      separateImagePools = props.limits.bufferImageGranularity > 1;
+      maxAllocationCount = props.limits.maxMemoryAllocationCount;
+      // vkGet*MemoryRequirements2 and VkMemoryDedicatedRequirements are core in 1.1.
+      dedicatedQueryable = props.apiVersion >= VK_API_VERSION_1_1;
+
+      pools.resize(memProperties.memoryTypeCount * 2);
+    }
+
+    ~VulkanAllocator() {
+      for (auto &pool : pools) {
+        for (auto &block : pool) {
+          vkFreeMemory(device, block->memory, nullptr);
+        }
+      }
+      for (auto &[memory, size] : dedicated) {
+        vkFreeMemory(device, memory, nullptr);
+      }
+    }
+
+    VulkanAllocator(const VulkanAllocator &) = delete;
+    VulkanAllocator &operator=(const VulkanAllocator &) = delete;
+
+    [[nodiscard]] uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+      for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) &&
+          (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+          return i;
+        }
+      }
+
+      throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    GpuAllocation allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties) {
+      VkMemoryRequirements requirements;
+      bool prefersDedicated = false;
+      if (dedicatedQueryable) {
+        VkBufferMemoryRequirementsInfo2 info{};
+        info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+        info.buffer = buffer;
+        VkMemoryDedicatedRequirements dedicatedReqs{};
+        dedicatedReqs.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+        VkMemoryRequirements2 reqs2{};
+        reqs2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        reqs2.pNext = &dedicatedReqs;
+        vkGetBufferMemoryRequirements2(device, &info, &reqs2);
+        requirements = reqs2.memoryRequirements;
+        prefersDedicated = dedicatedReqs.prefersDedicatedAllocation || dedicatedReqs.requiresDedicatedAllocation;
+      } else {
+        vkGetBufferMemoryRequirements(device, buffer, &requirements);
+      }
+      return allocate(requirements, properties, ResourceKind::Linear, prefersDedicated, buffer, VK_NULL_HANDLE);
+    }
+
+    GpuAllocation allocateForImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties) {
+      VkMemoryRequirements requirements;
+      bool prefersDedicated = false;
+      if (dedicatedQueryable) {
+        VkImageMemoryRequirementsInfo2 info{};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+        info.image = image;
+        VkMemoryDedicatedRequirements dedicatedReqs{};
+        dedicatedReqs.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+        VkMemoryRequirements2 reqs2{};
+        reqs2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        reqs2.pNext = &dedicatedReqs;
+        vkGetImageMemoryRequirements2(device, &info, &reqs2);
+        requirements = reqs2.memoryRequirements;
+        prefersDedicated = dedicatedReqs.prefersDedicatedAllocation || dedicatedReqs.requiresDedicatedAllocation;
+      } else {
+        vkGetImageMemoryRequirements(device, image, &requirements);
+      }
+      ResourceKind kind = tiling == VK_IMAGE_TILING_OPTIMAL ? ResourceKind::Optimal : ResourceKind::Linear;
+      return allocate(requirements, properties, kind, prefersDedicated, VK_NULL_HANDLE, image);
+    }
+
+    void free(GpuAllocation &allocation) {
+      if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+      }
+
+      if (allocation.block == nullptr) {
+        vkFreeMemory(device, allocation.memory, nullptr);
+        dedicated.erase(allocation.memory);
+        stats.dedicatedCount--;
+        stats.allocationCount--;
+        stats.reservedBytes -= allocation.size;
+        stats.usedBytes -= allocation.size;
+        allocation = {};
+        return;
+      }
+
+      GpuMemoryBlock *block = allocation.block;
+      releaseRange(*block, allocation.offset, allocation.size);
+      block->allocationCount--;
+      block->usedBytes -= allocation.size;
+      stats.allocationCount--;
+      stats.usedBytes -= allocation.size;
+
+      // Keep one empty block per pool around so a free/allocate cycle does not hit the driver.
+      auto &pool = pools[block->pool];
+      if (block->allocationCount == 0 && pool.size() > 1) {
+        auto it = std::find_if(pool.begin(), pool.end(),
+                               [block](const auto &candidate) { return candidate.get() == block; });
+        vkFreeMemory(device, block->memory, nullptr);
+        stats.blockCount--;
+        stats.reservedBytes -= block->size;
+        pool.erase(it);
+      }
+      allocation = {};
+    }
+
+    [[nodiscard]] const GpuMemoryStats &getStats() const { return stats; }
+
+  private:
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memProperties{};
+    VkDeviceSize preferredBlockSize;
+    bool separateImagePools = true;
+    bool dedicatedQueryable = false;
+    uint32_t maxAllocationCount = 4096;
+
+    // Indexed by memoryType * 2 + ResourceKind.
+    std::vector<std::vector<std::unique_ptr<GpuMemoryBlock>>> pools;
+    std::map<VkDeviceMemory, VkDeviceSize> dedicated;
+    GpuMemoryStats stats;
+
+    static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+      return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Small heaps (integrated GPUs, BAR windows) get proportionally smaller blocks.
+    VkDeviceSize blockSizeFor(uint32_t memoryType) const {
+      VkDeviceSize heapSize = memProperties.memoryHeaps[memProperties.memoryTypes[memoryType].heapIndex].size;
+      return std::min(preferredBlockSize, std::max<VkDeviceSize>(heapSize / 8, 1024 * 1024));
+    }
+
+    bool isHostVisible(uint32_t memoryType) const {
+      return memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    }
+
+    GpuAllocation allocate(const VkMemoryRequirements &requirements,
+                           VkMemoryPropertyFlags properties,
+                           ResourceKind kind,
+                           bool prefersDedicated,
+                           VkBuffer dedicatedBuffer,
+                           VkImage dedicatedImage) {
+      uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+      VkDeviceSize blockSize = blockSizeFor(memoryType);
+
+      if (prefersDedicated || requirements.size > blockSize / 2) {
+        return allocateDedicated(requirements.size, memoryType, dedicatedBuffer, dedicatedImage);
+      }
+
+      uint32_t poolIndex = memoryType * 2 + (separateImagePools ? static_cast<uint32_t>(kind) : 0);
+      auto &pool = pools[poolIndex];
+      for (auto &block : pool) {
+        VkDeviceSize offset;
+        if (takeRange(*block, requirements.size, requirements.alignment, offset)) {
+          return subAllocation(*block, offset, requirements.size, memoryType);
+        }
+      }
+
+      pool.push_back(createBlock(blockSize, memoryType, poolIndex));
+      VkDeviceSize offset;
+      if (!takeRange(*pool.back(), requirements.size, requirements.alignment, offset)) {
+        throw std::runtime_error("failed to sub-allocate from a fresh memory block!");
+      }
+      return subAllocation(*pool.back(), offset, requirements.size, memoryType);
+    }
+
+    GpuAllocation subAllocation(GpuMemoryBlock &block, VkDeviceSize offset, VkDeviceSize size, uint32_t memoryType) {
+      block.allocationCount++;
+      block.usedBytes += size;
+      stats.allocationCount++;
+      stats.usedBytes += size;
+
+      GpuAllocation allocation;
+      allocation.memory = block.memory;
+      allocation.offset = offset;
+      allocation.size = size;
+      allocation.mapped = block.mapped ? block.mapped + offset : nullptr;
+      allocation.memoryType = memoryType;
+      allocation.block = &block;
+      return allocation;
+    }
+
+    std::unique_ptr<GpuMemoryBlock> createBlock(VkDeviceSize size, uint32_t memoryType, uint32_t poolIndex) {
+      auto block = std::make_unique<GpuMemoryBlock>();
+      block->memory = allocateMemory(size, memoryType, nullptr);
+      block->size = size;
+      block->pool = poolIndex;
+      block->freeRanges[0] = size;
+      if (isHostVisible(memoryType)) {
+        void *data;
+        if (vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS) {
+          throw std::runtime_error("failed to map memory block!");
+        }
+        block->mapped = static_cast<uint8_t *>(data);
+      }
+
+      stats.blockCount++;
+      stats.reservedBytes += size;
+      return block;
+    }
+
+    GpuAllocation allocateDedicated(VkDeviceSize size, uint32_t memoryType, VkBuffer buffer, VkImage image) {
+      VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+      dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+      dedicatedInfo.buffer = buffer;
+      dedicatedInfo.image = image;
+
+      GpuAllocation allocation;
+      allocation.memory = allocateMemory(size, memoryType, dedicatedQueryable ? &dedicatedInfo : nullptr);
+      allocation.size = size;
+      allocation.memoryType = memoryType;
+      if (isHostVisible(memoryType)) {
+        if (vkMapMemory(device, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped) != VK_SUCCESS) {
+          throw std::runtime_error("failed to map dedicated allocation!");
+        }
+      }
+
+      dedicated[allocation.memory] = size;
+      stats.dedicatedCount++;
+      stats.allocationCount++;
+      stats.reservedBytes += size;
+      stats.usedBytes += size;
+      return allocation;
+    }
+
+    VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryType, const void *pNext) {
+      if (stats.blockCount + stats.dedicatedCount >= maxAllocationCount) {
+        throw std::runtime_error("exceeded maxMemoryAllocationCount!");
+      }
+
+      VkMemoryAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      allocInfo.pNext = pNext;
+      allocInfo.allocationSize = size;
+      allocInfo.memoryTypeIndex = memoryType;
+
+      VkDeviceMemory memory;
+      if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate device memory!");
+      }
+      stats.vkAllocateCalls++;
+      return memory;
+    }
+
+    // First fit. The alignment padding in front of the allocation stays on the free list.
+    static bool takeRange(GpuMemoryBlock &block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset) {
+      for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+        VkDeviceSize rangeBegin = it->first;
+        VkDeviceSize rangeEnd = it->first + it->second;
+        VkDeviceSize aligned = alignUp(rangeBegin, std::max<VkDeviceSize>(alignment, 1));
+        if (aligned + size > rangeEnd) {
+          continue;
+        }
+
+        block.freeRanges.erase(it);
+        if (aligned > rangeBegin) {
+          block.freeRanges[rangeBegin] = aligned - rangeBegin;
+        }
+        if (aligned + size < rangeEnd) {
+          block.freeRanges[aligned + size] = rangeEnd - (aligned + size);
+        }
+        offset = aligned;
+        return true;
+      }
+      return false;
+    }
+
+    static void releaseRange(GpuMemoryBlock &block, VkDeviceSize offset, VkDeviceSize size) {
+      auto next = block.freeRanges.lower_bound(offset);
+      if (next != block.freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = block.freeRanges.erase(next);
+      }
+      if (next != block.freeRanges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+          prev->second += size;
+          return;
+        }
+      }
+      block.freeRanges[offset] = size;
+    }
+};
@@ -6,55 +6,160 @@
 #include "VulkanDevice.cpp"
 #include <vector>
 
+// Command pools for the frame loop: every frame slot has one transient pool per recording
+// worker, reset all at once when the slot comes round instead of buffer by buffer. Worker 0 is
+// the thread that records the primary buffer, which is allocated from its pool. A separate
+// long-lived pool serves one-off command buffers such as readbacks, and another the buffers
+// that are recorded once and resubmitted frame after frame.
 class VulkanCommands {
   public:
-    VulkanCommands(std::shared_ptr<VulkanDevice> device, uint32_t maxFramesInFlight)
-      : devicePtr(device), maxFramesInFlight(maxFramesInFlight) {
+    VulkanCommands(std::shared_ptr<VulkanDevice> device, uint32_t maxFramesInFlight, uint32_t workerCount = 1)
+      : devicePtr(device), maxFramesInFlight(maxFramesInFlight), workerCount(std::max<uint32_t>(workerCount, 1)) {
       createCommandPool();
+      staticPool = createPool(0);
+      createFramePools();
       allocateCommandBuffers();
     }
 
     ~VulkanCommands() {
+      for (auto &frame : frames) {
+        for (auto &worker : frame) {
+          vkDestroyCommandPool(device(), worker.pool, nullptr);
+        }
+      }
+      if (staticPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(device(), staticPool, nullptr);
+      }
       if (commandPool != VK_NULL_HANDLE) {
         vkDestroyCommandPool(device(), commandPool, nullptr);
       }
     }
 
     VkCommandPool getCommandPool() const { return commandPool; }
+    // One primary buffer per frame slot.
     const std::vector<VkCommandBuffer> &getCommandBuffers() const { return commandBuffers; }
+    uint32_t getWorkerCount() const { return workerCount; }
+
+    // Recycles every buffer recorded for the slot. Only call once its fence has signaled.
+    void resetFrame(uint32_t frameIndex) {
+      for (auto &worker : frames[frameIndex]) {
+        if (vkResetCommandPool(device(), worker.pool, 0) != VK_SUCCESS) {
+          throw std::runtime_error("failed to reset command pool!");
+        }
+        worker.usedSecondaries = 0;
+      }
+    }
+
+    // The worker's next unused secondary buffer this frame, allocated on first use. Workers only
+    // touch their own pool, so different workers may call this concurrently.
+    VkCommandBuffer acquireSecondary(uint32_t frameIndex, uint32_t worker) {
+      WorkerCommands &commands = frames[frameIndex][worker];
+      if (commands.usedSecondaries == commands.secondaries.size()) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commands.pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer secondary;
+        if (vkAllocateCommandBuffers(device(), &allocInfo, &secondary) != VK_SUCCESS) {
+          throw std::runtime_error("failed to allocate secondary command buffer!");
+        }
+        commands.secondaries.push_back(secondary);
+      }
+      return commands.secondaries[commands.usedSecondaries++];
+    }
+
+    // Reusable primary buffer `index`, allocated on first use. It survives resetFrame; record it
+    // once and submit it as often as its contents stay valid.
+    VkCommandBuffer getStaticBuffer(size_t index) {
+      if (index >= staticBuffers.size()) {
+        staticBuffers.resize(index + 1, VK_NULL_HANDLE);
+      }
+      if (staticBuffers[index] == VK_NULL_HANDLE) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = staticPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(device(), &allocInfo, &staticBuffers[index]) != VK_SUCCESS) {
+          throw std::runtime_error("failed to allocate static command buffer!");
+        }
+      }
+      return staticBuffers[index];
+    }
+
+    // Starts a fresh pool for the static buffers and returns the old one, whose buffers frames
+    // already submitted may still be executing; the caller destroys it once they have finished.
+    [[nodiscard]] VkCommandPool retireStaticPool() {
+      VkCommandPool previous = staticPool;
+      staticPool = createPool(0);
+      staticBuffers.clear();
+      return previous;
+    }
 
   private:
+    struct WorkerCommands {
+      VkCommandPool pool = VK_NULL_HANDLE;
+      std::vector<VkCommandBuffer> secondaries;
+      size_t usedSecondaries = 0;
+    };
+
     std::shared_ptr<VulkanDevice> devicePtr;
     VkCommandPool commandPool = VK_NULL_HANDLE;
     std::vector<VkCommandBuffer> commandBuffers;
+    VkCommandPool staticPool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> staticBuffers;
+    // [frame slot][worker]
+    std::vector<std::vector<WorkerCommands>> frames;
     uint32_t maxFramesInFlight;
+    uint32_t workerCount;
 
     VkDevice device() const { return devicePtr->getDevice(); }
 
-    void createCommandPool() {
+    VkCommandPool createPool(VkCommandPoolCreateFlags flags) {
       QueueFamilyIndices queueFamilyIndices = devicePtr->getQueueFamilyIndices();
 
       VkCommandPoolCreateInfo poolInfo{};
       poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-      poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+      poolInfo.flags = flags;
       poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
-      if (vkCreateCommandPool(device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+      VkCommandPool pool;
+      if (vkCreateCommandPool(device(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool!");
       }
+      return pool;
+    }
+
+    void createCommandPool() {
+      commandPool = createPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    }
+
+    void createFramePools() {
+      frames.resize(maxFramesInFlight);
+      for (auto &frame : frames) {
+        frame.resize(workerCount);
+        for (auto &worker : frame) {
+          worker.pool = createPool(VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+        }
+      }
     }
 
     void allocateCommandBuffers() {
       commandBuffers.resize(maxFramesInFlight);
 
-      VkCommandBufferAllocateInfo allocInfo{};
-      allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-      allocInfo.commandPool = commandPool;
-      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-      allocInfo.commandBufferCount = (uint32_t) commandBuffers.size();
+      for (uint32_t i = 0; i < maxFramesInFlight; i++) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = frames[i][0].pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
 
-      if (vkAllocateCommandBuffers(device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate command buffers!");
+        if (vkAllocateCommandBuffers(device(), &allocInfo, &commandBuffers[i]) != VK_SUCCESS) {
+          throw std::runtime_error("failed to allocate command buffers!");
+        }
       }
     }
 };
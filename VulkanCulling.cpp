@@ -0,0 +1,460 @@
+//
+// Created by Elijah Crain on 10/17/26.
+//
+#pragma once
+
+#include "VulkanDevice.cpp"
+#include "VulkanPipeline.cpp"
+#include "VulkanDescriptor.cpp"
+#include "Util.cpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <array>
+#include <string>
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+// Levels of detail per variant; must match LOD_COUNT in cull.comp.
+constexpr uint32_t CULL_LOD_COUNT = 3;
+
+// One mesh type whose instances' visibility and level of detail are decided on the GPU: its
+// range of the instance buffer and, most detailed first, where each LOD sits in the merged
+// geometry.
+struct CullVariant {
+  uint32_t firstInstance = 0;
+  uint32_t instanceCount = 0;
+  std::array<MeshRange, CULL_LOD_COUNT> lods{};
+};
+
+// GPU frustum culling and LOD selection. Per frame slot, a compute pass tests every instance's
+// offset against the camera frustum and picks a LOD from the projected diameter of its bounding
+// sphere; a first dispatch counts the instances of each variant and LOD into instanceCount of
+// the matching VkDrawIndexedIndirectCommand, a second lays those ranges out back to back in a
+// compacted instance buffer no larger than the source one, sets each command's firstInstance and
+// copies the instances in. The commands carry each range's firstIndex, vertexOffset and
+// firstInstance, so every variant and LOD of the lattice is drawn by a single
+// vkCmdDrawIndexedIndirect; off-screen hexes never reach the vertex shader and distant ones only
+// cost a handful of triangles. Devices that cannot take firstInstance from an indirect command
+// get fixed ranges at offsets the CPU knows instead, which reserves every LOD for every
+// instance. The camera reaches the dispatch through a per-slot uniform block written by
+// writeParams rather than through the command buffer, so a recorded cull pass stays valid while
+// the camera moves.
+class VulkanCulling {
+  public:
+    static constexpr uint32_t WORKGROUP_SIZE = 256;
+    static constexpr uint32_t LOD_COUNT = CULL_LOD_COUNT;
+    static constexpr VkDeviceSize COMMAND_STRIDE = sizeof(VkDrawIndexedIndirectCommand);
+
+    VulkanCulling(std::shared_ptr<VulkanDevice> device,
+                  uint32_t maxFramesInFlight,
+                  const SpirvCode &compShader,
+                  VertexFormat vertexFormat,
+                  VkPipelineCache pipelineCache = VK_NULL_HANDLE)
+      : devicePtr(std::move(device)), maxFramesInFlight(maxFramesInFlight),
+        instanceBytes(instanceStride(vertexFormat)), specialization(vertexFormat), pipelineCache(pipelineCache),
+        fixedRanges(!devicePtr->supportsMultiDrawIndirect()) {
+      VkPhysicalDeviceProperties props;
+      vkGetPhysicalDeviceProperties(devicePtr->getPhysicalDevice(), &props);
+      offsetAlignment = std::max<VkDeviceSize>(props.limits.minStorageBufferOffsetAlignment, 4);
+      maxStorageBufferRange = props.limits.maxStorageBufferRange;
+      maxWorkGroupCount = std::to_array(props.limits.maxComputeWorkGroupCount);
+      VkDeviceSize uniformAlignment = std::max<VkDeviceSize>(props.limits.minUniformBufferOffsetAlignment, 1);
+      paramsStride = (sizeof(CullParams) + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+
+      createParamsBuffer();
+      createDescriptorSetLayout();
+      createPipeline(compShader);
+      createDescriptorPool();
+      frames.resize(maxFramesInFlight);
+    }
+
+    ~VulkanCulling() {
+      destroyFrameBuffers();
+      devicePtr->destroyBuffer(paramsBuffer, paramsMemory);
+      vkDestroyDescriptorPool(device(), descriptorPool, nullptr);
+      vkDestroyPipeline(device(), pipeline, nullptr);
+      vkDestroyPipelineLayout(device(), pipelineLayout, nullptr);
+      vkDestroyDescriptorSetLayout(device(), descriptorSetLayout, nullptr);
+    }
+
+    // Swaps in a pipeline built from new code and returns the old one, which frames already
+    // recorded may still use; the caller destroys it once they have finished.
+    [[nodiscard]] VkPipeline reloadPipeline(const SpirvCode &compShader) {
+      VkPipeline previous = pipeline;
+      pipeline = createComputePipeline(device(), pipelineCache, pipelineLayout, compShader, &specialization.info);
+      return previous;
+    }
+
+    // (Re)builds output buffers and descriptor sets. `instances` holds one buffer per frame
+    // slot, and `newVariants` its contiguous ranges in order from the start. Only call while the
+    // device is idle.
+    void setVariants(const std::vector<VkBuffer> &instances, const std::vector<CullVariant> &newVariants) {
+      if (instances.size() != maxFramesInFlight) {
+        throw std::runtime_error("culling needs one instance buffer per frame slot!");
+      }
+      if (newVariants.empty()) {
+        throw std::runtime_error("culling needs at least one variant!");
+      }
+      uint32_t expectedFirst = 0;
+      for (const auto &variant : newVariants) {
+        if (variant.firstInstance != expectedFirst) {
+          throw std::runtime_error("cull variants must cover the instances in order!");
+        }
+        expectedFirst += variant.instanceCount;
+      }
+      destroyFrameBuffers();
+      vkResetDescriptorPool(device(), descriptorPool, 0);
+      variants = newVariants;
+      instanceCount = expectedFirst;
+      buildCommandTemplate();
+
+      VkDeviceSize sourceBytes = instanceBytes * std::max<uint32_t>(instanceCount, 1);
+      VkDeviceSize visibleBytes = fixedRanges ? sourceBytes * LOD_COUNT : sourceBytes;
+      if (visibleBytes > maxStorageBufferRange) {
+        throw std::runtime_error("too many instances to cull within maxStorageBufferRange!");
+      }
+      for (uint32_t f = 0; f < maxFramesInFlight; f++) {
+        FrameBuffers &frame = frames[f];
+        devicePtr->createBuffer(commandTemplate.size(),
+                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                                | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                                | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                frame.commands,
+                                frame.commandsMemory);
+        devicePtr->createBuffer(visibleBytes,
+                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                frame.visible,
+                                frame.visibleMemory);
+        frame.descriptorSet = allocateDescriptorSet(f, instances[f], sourceBytes, frame.visible, visibleBytes, frame.commands);
+      }
+    }
+
+    // Sets the camera the slot's next cull pass runs with. lodScreenSizes are the smallest
+    // projected diameters, in pixels, drawn at LOD 0 and LOD 1; anything smaller falls to the
+    // last LOD. The slot's fence must have signaled.
+    void writeParams(uint32_t frameIndex,
+                     const UniformBufferObject &ubo,
+                     float boundingRadius,
+                     float viewportHeight,
+                     const std::array<float, 2> &lodScreenSizes) {
+      CullParams params{};
+      extractFrustumPlanes(ubo.proj * ubo.view * ubo.model, params.planes);
+      // proj[1][1] is 1 / tan(fovy / 2): a unit length at unit distance covers half that many
+      // viewport heights.
+      params.camera = glm::vec4(glm::vec3(glm::inverse(ubo.view * ubo.model)[3]),
+                                ubo.proj[1][1] * viewportHeight * 0.5f);
+      params.instanceCount = instanceCount;
+      params.boundingRadius = boundingRadius;
+      params.lodScreenSizes = glm::vec2(lodScreenSizes[0], lodScreenSizes[1]);
+      params.fixedRanges = fixedRanges ? 1 : 0;
+      memcpy(static_cast<uint8_t *>(paramsMemory.mapped) + paramsStride * frameIndex, &params, sizeof(params));
+    }
+
+    // Records the reset, the count and scatter dispatches and the barriers that hand the results
+    // to the draws. Must be called outside a render pass.
+    void record(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+      FrameBuffers &frame = frames[frameIndex];
+
+      vkCmdUpdateBuffer(commandBuffer, frame.commands, 0, commandTemplate.size(), commandTemplate.data());
+
+      // Also orders this frame's cull writes after the draws that last read the buffers.
+      VkMemoryBarrier resetBarrier{};
+      resetBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+      vkCmdPipelineBarrier(commandBuffer,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           0,
+                           1, &resetBarrier,
+                           0, nullptr,
+                           0, nullptr);
+
+      if (instanceCount > 0) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        vkCmdBindDescriptorSets(commandBuffer,
+                                VK_PIPELINE_BIND_POINT_COMPUTE,
+                                pipelineLayout,
+                                0,
+                                1,
+                                &frame.descriptorSet,
+                                0,
+                                nullptr);
+        // The scatter pass also covers every command, to set its firstInstance.
+        const uint32_t invocations = std::max(instanceCount, getCommandCount());
+
+        uint32_t scatter = 0;
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(scatter), &scatter);
+        dispatchItems(commandBuffer, invocations, WORKGROUP_SIZE, maxWorkGroupCount);
+
+        VkMemoryBarrier countBarrier{};
+        countBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        countBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        countBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0,
+                             1, &countBarrier,
+                             0, nullptr,
+                             0, nullptr);
+
+        scatter = 1;
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(scatter), &scatter);
+        dispatchItems(commandBuffer, invocations, WORKGROUP_SIZE, maxWorkGroupCount);
+      }
+
+      VkMemoryBarrier cullBarrier{};
+      cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+      cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+      vkCmdPipelineBarrier(commandBuffer,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                           0,
+                           1, &cullBarrier,
+                           0, nullptr,
+                           0, nullptr);
+    }
+
+    VkBuffer getVisibleInstances(uint32_t frameIndex) const { return frames[frameIndex].visible; }
+    VkBuffer getIndirectBuffer(uint32_t frameIndex) const { return frames[frameIndex].commands; }
+    // Commands in getIndirectBuffer, COMMAND_STRIDE apart: variant * LOD_COUNT + lod.
+    [[nodiscard]] uint32_t getCommandCount() const { return static_cast<uint32_t>(variants.size()) * LOD_COUNT; }
+    // Byte offset of a command's range within getVisibleInstances, for drawing it on its own
+    // where the device cannot take firstInstance from an indirect command, and so the ranges
+    // are fixed.
+    VkDeviceSize getVisibleOffset(uint32_t command) const {
+      return instanceBytes * fixedFirst(command / LOD_COUNT, command % LOD_COUNT);
+    }
+
+  private:
+    // std140 layout of the CullParams block in cull.comp.
+    struct CullParams {
+      glm::vec4 planes[6];
+      glm::vec4 camera;
+      uint32_t instanceCount;
+      float boundingRadius;
+      glm::vec2 lodScreenSizes;
+      uint32_t fixedRanges;
+      uint32_t padding[3];
+    };
+    static_assert(sizeof(CullParams) == 144);
+    static constexpr uint32_t PARAMS_BINDING = 4;
+    static constexpr uint32_t BINDING_COUNT = 6;
+
+    // The commands followed, at variantTableOffset, by each variant's end for cull.comp and, at
+    // cursorOffset, the scatter pass's cursor for each command.
+    struct FrameBuffers {
+      VkBuffer commands = VK_NULL_HANDLE;
+      GpuAllocation commandsMemory;
+      VkBuffer visible = VK_NULL_HANDLE;
+      GpuAllocation visibleMemory;
+      VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    };
+
+    std::shared_ptr<VulkanDevice> devicePtr;
+    uint32_t maxFramesInFlight;
+    VkDeviceSize offsetAlignment = 4;
+    VkDeviceSize maxStorageBufferRange = 0;
+    std::array<uint32_t, 3> maxWorkGroupCount{};
+    // Size of one instance record in the layout being drawn.
+    VkDeviceSize instanceBytes;
+    InstanceLayoutSpecialization specialization;
+    VkDeviceSize variantTableOffset = 0;
+    VkDeviceSize cursorOffset = 0;
+    // One CullParams per frame slot, paramsStride apart, persistently mapped.
+    VkBuffer paramsBuffer = VK_NULL_HANDLE;
+    GpuAllocation paramsMemory;
+    VkDeviceSize paramsStride = 0;
+
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    // The device cannot take firstInstance from an indirect command; see the class comment.
+    bool fixedRanges;
+
+    std::vector<CullVariant> variants;
+    uint32_t instanceCount = 0;
+    // What every frame's commands buffer is reset to before culling: zero instances per command
+    // and zeroed cursors.
+    std::vector<uint8_t> commandTemplate;
+    std::vector<FrameBuffers> frames;
+
+    VkDevice device() const { return devicePtr->getDevice(); }
+
+    // First instance of a variant's LOD range in the visible buffer with fixed ranges; matches
+    // rangeFirst in cull.comp.
+    [[nodiscard]] uint32_t fixedFirst(uint32_t variant, uint32_t lod) const {
+      return LOD_COUNT * variants[variant].firstInstance + lod * variants[variant].instanceCount;
+    }
+
+    // firstInstance starts at 0: the scatter pass fills it in, or with fixed ranges the draws
+    // bind each range at its offset instead.
+    void buildCommandTemplate() {
+      std::vector<VkDrawIndexedIndirectCommand> commands;
+      std::vector<uint32_t> ends;
+      for (uint32_t v = 0; v < variants.size(); v++) {
+        for (uint32_t lod = 0; lod < LOD_COUNT; lod++) {
+          VkDrawIndexedIndirectCommand command{};
+          command.indexCount = variants[v].lods[lod].indexCount;
+          command.firstIndex = variants[v].lods[lod].firstIndex;
+          command.vertexOffset = variants[v].lods[lod].vertexOffset;
+          commands.push_back(command);
+        }
+        ends.push_back(variants[v].firstInstance + variants[v].instanceCount);
+      }
+
+      VkDeviceSize commandBytes = COMMAND_STRIDE * commands.size();
+      variantTableOffset = (commandBytes + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+      VkDeviceSize variantTableEnd = variantTableOffset + sizeof(uint32_t) * ends.size();
+      cursorOffset = (variantTableEnd + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+      commandTemplate.assign(cursorOffset + sizeof(uint32_t) * commands.size(), 0);
+      memcpy(commandTemplate.data(), commands.data(), commandBytes);
+      memcpy(commandTemplate.data() + variantTableOffset, ends.data(), sizeof(uint32_t) * ends.size());
+      if (commandTemplate.size() > 65536) {
+        throw std::runtime_error("too many cull variants for vkCmdUpdateBuffer!");
+      }
+    }
+
+    // Gribb-Hartmann: planes are sums/differences of the clip matrix rows. The near plane uses
+    // the -w..w convention, which is looser than Vulkan's 0..w and so stays conservative.
+    static void extractFrustumPlanes(const glm::mat4 &clip, glm::vec4 (&planes)[6]) {
+      auto row = [&](int r) { return glm::vec4(clip[0][r], clip[1][r], clip[2][r], clip[3][r]); };
+      planes[0] = row(3) + row(0);
+      planes[1] = row(3) - row(0);
+      planes[2] = row(3) + row(1);
+      planes[3] = row(3) - row(1);
+      planes[4] = row(3) + row(2);
+      planes[5] = row(3) - row(2);
+      for (auto &plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+      }
+    }
+
+    void destroyFrameBuffers() {
+      for (auto &frame : frames) {
+        if (frame.commands != VK_NULL_HANDLE) {
+          devicePtr->destroyBuffer(frame.commands, frame.commandsMemory);
+          frame.commands = VK_NULL_HANDLE;
+        }
+        if (frame.visible != VK_NULL_HANDLE) {
+          devicePtr->destroyBuffer(frame.visible, frame.visibleMemory);
+          frame.visible = VK_NULL_HANDLE;
+        }
+      }
+    }
+
+    void createParamsBuffer() {
+      devicePtr->createBuffer(paramsStride * maxFramesInFlight,
+                              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              paramsBuffer,
+                              paramsMemory);
+    }
+
+    // Bindings 0-3 and 5 are the storage buffers, 4 the parameters.
+    void createDescriptorSetLayout() {
+      std::array<VkDescriptorSetLayoutBinding, BINDING_COUNT> bindings{};
+      for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = i == PARAMS_BINDING ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                                                         : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+      }
+
+      VkDescriptorSetLayoutCreateInfo layoutInfo{};
+      layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+      layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+      layoutInfo.pBindings = bindings.data();
+
+      if (vkCreateDescriptorSetLayout(device(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull descriptor set layout!");
+      }
+    }
+
+    // The push constant is the pass: 0 counts, 1 scatters.
+    void createPipeline(const SpirvCode &compShader) {
+      VkPushConstantRange pushConstantRange{};
+      pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+      pushConstantRange.offset = 0;
+      pushConstantRange.size = sizeof(uint32_t);
+
+      VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+      pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+      pipelineLayoutInfo.setLayoutCount = 1;
+      pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+      pipelineLayoutInfo.pushConstantRangeCount = 1;
+      pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+      if (vkCreatePipelineLayout(device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull pipeline layout!");
+      }
+
+      pipeline = createComputePipeline(device(), pipelineCache, pipelineLayout, compShader, &specialization.info);
+    }
+
+    void createDescriptorPool() {
+      std::array<VkDescriptorPoolSize, 2> poolSizes{};
+      poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      poolSizes[0].descriptorCount = (BINDING_COUNT - 1) * maxFramesInFlight;
+      poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      poolSizes[1].descriptorCount = maxFramesInFlight;
+
+      VkDescriptorPoolCreateInfo poolInfo{};
+      poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+      poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+      poolInfo.pPoolSizes = poolSizes.data();
+      poolInfo.maxSets = maxFramesInFlight;
+
+      if (vkCreateDescriptorPool(device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull descriptor pool!");
+      }
+    }
+
+    VkDescriptorSet allocateDescriptorSet(uint32_t frameIndex,
+                                          VkBuffer source,
+                                          VkDeviceSize sourceBytes,
+                                          VkBuffer visible,
+                                          VkDeviceSize visibleBytes,
+                                          VkBuffer commands) {
+      VkDescriptorSetAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+      allocInfo.descriptorPool = descriptorPool;
+      allocInfo.descriptorSetCount = 1;
+      allocInfo.pSetLayouts = &descriptorSetLayout;
+
+      VkDescriptorSet descriptorSet;
+      if (vkAllocateDescriptorSets(device(), &allocInfo, &descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate cull descriptor set!");
+      }
+
+      std::array<VkDescriptorBufferInfo, BINDING_COUNT> bufferInfos{};
+      bufferInfos[0] = {source, 0, sourceBytes};
+      bufferInfos[1] = {visible, 0, visibleBytes};
+      bufferInfos[2] = {commands, 0, COMMAND_STRIDE * getCommandCount()};
+      bufferInfos[3] = {commands, variantTableOffset, sizeof(uint32_t) * variants.size()};
+      bufferInfos[PARAMS_BINDING] = {paramsBuffer, paramsStride * frameIndex, sizeof(CullParams)};
+      bufferInfos[5] = {commands, cursorOffset, sizeof(uint32_t) * getCommandCount()};
+
+      std::array<VkWriteDescriptorSet, BINDING_COUNT> writes{};
+      for (uint32_t i = 0; i < writes.size(); i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = descriptorSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorType = i == PARAMS_BINDING ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                                                       : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].descriptorCount = 1;
+        writes[i].pBufferInfo = &bufferInfos[i];
+      }
+      vkUpdateDescriptorSets(device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+      return descriptorSet;
+    }
+};
@@ -0,0 +1,42 @@
+//
+// Created by Elijah Crain on 10/17/26.
+//
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <cstdint>
+
+// Destroys objects that already-submitted frames may still be using, once those frames have
+// finished. Each entry is keyed by how many frames had been submitted when it was retired, and
+// runs as soon as that many frames are known to be complete.
+class VulkanDeletionQueue {
+  public:
+    void push(uint64_t submittedFrames, std::function<void()> destroy) {
+      entries.push_back({submittedFrames, std::move(destroy)});
+    }
+
+    // Runs every entry whose frames are among the first `completedFrames` to finish. Entries are
+    // pushed with non-decreasing keys, so they retire in order.
+    void collect(uint64_t completedFrames) {
+      while (!entries.empty() && entries.front().submittedFrames <= completedFrames) {
+        std::function<void()> destroy = std::move(entries.front().destroy);
+        entries.pop_front();
+        destroy();
+      }
+    }
+
+    // Runs everything; only call while the device is idle.
+    void flush() {
+      collect(UINT64_MAX);
+    }
+
+    [[nodiscard]] size_t size() const { return entries.size(); }
+
+  private:
+    struct Entry {
+      uint64_t submittedFrames;
+      std::function<void()> destroy;
+    };
+    std::deque<Entry> entries;
+};
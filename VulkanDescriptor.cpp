@@ -6,6 +6,9 @@
 #include "VulkanDevice.cpp"
 #include <utility>
 #include <vector>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "VulkanSwapChain.cpp"
@@ -18,14 +21,21 @@ struct UniformBufferObject {
   glm::mat4 proj;
 };
 
+// Uniform data lives in one persistently mapped buffer cut into blocksPerFrame slices per frame
+// in flight, each padded to minUniformBufferOffsetAlignment. A single UNIFORM_BUFFER_DYNAMIC set
+// covers all of it; draws pick their slice with the dynamic offset from getDynamicOffset. The
+// camera only goes through it for pre-recorded command buffers, which cannot push it; see
+// CameraPushConstants.
 class VulkanDescriptors {
   public:
+    static constexpr uint32_t DEFAULT_BLOCKS_PER_FRAME = 64;
+
     VulkanDescriptors(std::shared_ptr<VulkanDevice> device,
-                      std::shared_ptr<VulkanSwapChain> swapchain,
                       std::shared_ptr<VulkanWindow> window,
-                      uint32_t maxFramesInFlight)
-      : devicePtr(std::move(device)), swapChainPtr(std::move(swapchain)), windowPtr(std::move(window)),
-        maxFramesInFlight(maxFramesInFlight) {
+                      uint32_t maxFramesInFlight,
+                      uint32_t blocksPerFrame = DEFAULT_BLOCKS_PER_FRAME)
+      : devicePtr(std::move(device)), windowPtr(std::move(window)),
+        maxFramesInFlight(maxFramesInFlight), blocksPerFrame(blocksPerFrame) {
       createDescriptorSetLayout();
       createUniformBuffers();
       createDescriptorPool();
@@ -34,18 +44,33 @@ class VulkanDescriptors {
 
     ~VulkanDescriptors() {
       vkDestroyDescriptorPool(device(), descriptorPool, nullptr);
-      for (size_t i = 0; i < maxFramesInFlight; i++) {
-        vkDestroyBuffer(device(), uniformBuffers[i], nullptr);
-        vkFreeMemory(device(), uniformBuffersMemory[i], nullptr);
-      }
+      devicePtr->destroyBuffer(uniformBuffer, uniformBufferMemory);
 
       vkDestroyDescriptorSetLayout(device(), descriptorSetLayout, nullptr);
     }
 
     VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
-    const std::vector<VkDescriptorSet> &getDescriptorSets() const { return descriptorSets; }
+    VkDescriptorSet getDescriptorSet() const { return descriptorSet; }
+    uint32_t getBlocksPerFrame() const { return blocksPerFrame; }
+
+    // Offset to pass to vkCmdBindDescriptorSets for `block` of frame slot `currentFrame`.
+    uint32_t getDynamicOffset(size_t currentFrame, uint32_t block = 0) const {
+      return static_cast<uint32_t>((currentFrame * blocksPerFrame + block) * blockStride);
+    }
+
+    // The slot's fence must have signaled; the memory is coherent, so no flush is needed. Any
+    // block layout up to the size of UniformBufferObject fits.
+    template <typename Block>
+    void writeUniformBlock(size_t currentFrame, uint32_t block, const Block &data) {
+      static_assert(sizeof(Block) <= sizeof(UniformBufferObject));
+      if (block >= blocksPerFrame) {
+        throw std::out_of_range("uniform block index past blocksPerFrame!");
+      }
+      memcpy(uniformMapped + getDynamicOffset(currentFrame, block), &data, sizeof(data));
+    }
 
-    void updateUniformBuffer(size_t currentFrame) {
+    // The orbit camera for this frame. Nothing is written to the uniform buffer.
+    UniformBufferObject updateCamera(VkExtent2D extent) const {
       UniformBufferObject ubo{};
       ubo.model = glm::mat4(1.0f); // No rotation
 
@@ -65,37 +90,36 @@ class VulkanDescriptors {
         glm::vec3(0.0f, 1.0f, 0.0f)); //Up vector
 
       ubo.proj = glm::perspective(glm::radians(windowPtr->fov),
-                                  swapChainPtr->getExtent().width / (float) swapChainPtr->getExtent().height,
+                                  extent.width / (float) extent.height,
                                   0.1f,
                                   500.0f);
       //std::cout << "\n Camera Position: (" << cameraPos.x << ", " << cameraPos.y << ", " << cameraPos.z << ")\n";
       //std::cout << "FOV: " << fov << "\n";
 
-      void *data;
-      vkMapMemory(devicePtr->getDevice(), uniformBuffersMemory[currentFrame], 0, sizeof(ubo), 0, &data);
-      memcpy(data, &ubo, sizeof(ubo));
-      vkUnmapMemory(devicePtr->getDevice(), uniformBuffersMemory[currentFrame]);
+      return ubo;
     }
 
   private:
     std::shared_ptr<VulkanDevice> devicePtr;
-    std::shared_ptr<VulkanSwapChain> swapChainPtr;
     std::shared_ptr<VulkanWindow> windowPtr;
     uint32_t maxFramesInFlight;
+    uint32_t blocksPerFrame;
 
     VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
     VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
-    std::vector<VkDescriptorSet> descriptorSets;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 
-    std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformBuffersMemory;
+    VkBuffer uniformBuffer = VK_NULL_HANDLE;
+    GpuAllocation uniformBufferMemory;
+    uint8_t *uniformMapped = nullptr;
+    VkDeviceSize blockStride = 0;
 
     VkDevice device() const { return devicePtr->getDevice(); }
 
     void createDescriptorSetLayout() {
       VkDescriptorSetLayoutBinding uboLayoutBinding{};
       uboLayoutBinding.binding = 0;
-      uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
       uboLayoutBinding.descriptorCount = 1;
       uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
       uboLayoutBinding.pImmutableSamplers = nullptr;
@@ -111,32 +135,31 @@ class VulkanDescriptors {
     }
 
     void createUniformBuffers() {
-      VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-      uniformBuffers.resize(maxFramesInFlight);
-      uniformBuffersMemory.resize(maxFramesInFlight);
-
-      for (size_t i = 0; i < maxFramesInFlight; i++) {
-        devicePtr->createBuffer(
-          bufferSize,
-          VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-          uniformBuffers[i],
-          uniformBuffersMemory[i]
-        );
-      }
+      VkPhysicalDeviceProperties props;
+      vkGetPhysicalDeviceProperties(devicePtr->getPhysicalDevice(), &props);
+      VkDeviceSize alignment = std::max<VkDeviceSize>(props.limits.minUniformBufferOffsetAlignment, 1);
+      blockStride = (sizeof(UniformBufferObject) + alignment - 1) / alignment * alignment;
+
+      devicePtr->createBuffer(
+        blockStride * blocksPerFrame * maxFramesInFlight,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        uniformBuffer,
+        uniformBufferMemory
+      );
+      uniformMapped = static_cast<uint8_t *>(uniformBufferMemory.mapped);
     }
 
     void createDescriptorPool() {
       VkDescriptorPoolSize poolSize{};
-      poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      poolSize.descriptorCount = maxFramesInFlight;
+      poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+      poolSize.descriptorCount = 1;
 
       VkDescriptorPoolCreateInfo poolInfo{};
       poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
       poolInfo.poolSizeCount = 1;
       poolInfo.pPoolSizes = &poolSize;
-      poolInfo.maxSets = maxFramesInFlight;
+      poolInfo.maxSets = 1;
 
       if (vkCreateDescriptorPool(device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor pool!");
@@ -144,35 +167,30 @@ class VulkanDescriptors {
     }
 
     void createDescriptorSets() {
-      std::vector<VkDescriptorSetLayout> layouts(maxFramesInFlight, descriptorSetLayout);
-
       VkDescriptorSetAllocateInfo allocInfo{};
       allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
       allocInfo.descriptorPool = descriptorPool;
-      allocInfo.descriptorSetCount = maxFramesInFlight;
-      allocInfo.pSetLayouts = layouts.data();
+      allocInfo.descriptorSetCount = 1;
+      allocInfo.pSetLayouts = &descriptorSetLayout;
 
-      descriptorSets.resize(maxFramesInFlight);
-      if (vkAllocateDescriptorSets(device(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+      if (vkAllocateDescriptorSets(device(), &allocInfo, &descriptorSet) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate descriptor sets!");
       }
 
-      for (size_t i = 0; i < maxFramesInFlight; i++) {
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = uniformBuffers[i];
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UniformBufferObject);
-
-        VkWriteDescriptorSet descriptorWrite{};
-        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite.dstSet = descriptorSets[i];
-        descriptorWrite.dstBinding = 0;
-        descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrite.descriptorCount = 1;
-        descriptorWrite.pBufferInfo = &bufferInfo;
-
-        vkUpdateDescriptorSets(device(), 1, &descriptorWrite, 0, nullptr);
-      }
+      VkDescriptorBufferInfo bufferInfo{};
+      bufferInfo.buffer = uniformBuffer;
+      bufferInfo.offset = 0;
+      bufferInfo.range = sizeof(UniformBufferObject);
+
+      VkWriteDescriptorSet descriptorWrite{};
+      descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      descriptorWrite.dstSet = descriptorSet;
+      descriptorWrite.dstBinding = 0;
+      descriptorWrite.dstArrayElement = 0;
+      descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+      descriptorWrite.descriptorCount = 1;
+      descriptorWrite.pBufferInfo = &bufferInfo;
+
+      vkUpdateDescriptorSets(device(), 1, &descriptorWrite, 0, nullptr);
     }
 };
@@ -5,12 +5,14 @@
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include "VulkanAllocator.cpp"
 #include <vector>
 #include <optional>
 #include <set>
 #include <stdexcept>
 #include <algorithm>
 #include <cstdint>
+#include <memory>
 
 extern const std::vector<const char *> deviceExtensions;
 extern const bool enableValidationLayers;
@@ -26,9 +28,11 @@ const std::vector<const char *> deviceExtensions = {
 struct QueueFamilyIndices {
   std::optional<uint32_t> graphicsFamily;
   std::optional<uint32_t> presentFamily;
+  // Transfer-only family (no graphics), when the device has one; uploads prefer it.
+  std::optional<uint32_t> transferFamily;
 
-  [[nodiscard]] bool isComplete() const {
-    return graphicsFamily.has_value() && presentFamily.has_value();
+  [[nodiscard]] bool isComplete(bool needsPresent = true) const {
+    return graphicsFamily.has_value() && (presentFamily.has_value() || !needsPresent);
   }
 };
 
@@ -65,11 +69,12 @@ class VulkanDevice {
       return details;
     }
 
+    // Memory comes from the device's VulkanAllocator; release with destroyBuffer.
     void createBuffer(VkDeviceSize size,
                       VkBufferUsageFlags usage,
                       VkMemoryPropertyFlags properties,
                       VkBuffer &buffer,
-                      VkDeviceMemory &bufferMemory) {
+                      GpuAllocation &bufferMemory) {
       VkBufferCreateInfo bufferInfo{};
       bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
       bufferInfo.size = size;
@@ -80,19 +85,14 @@ class VulkanDevice {
         throw std::runtime_error("failed to create buffer!");
       }
 
-      VkMemoryRequirements memRequirements;
-      vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-      VkMemoryAllocateInfo allocInfo{};
-      allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      allocInfo.allocationSize = memRequirements.size;
-      allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-      if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate buffer memory!");
-      }
+      bufferMemory = allocator->allocateForBuffer(buffer, properties);
+      vkBindBufferMemory(device, buffer, bufferMemory.memory, bufferMemory.offset);
+    }
 
-      vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    void destroyBuffer(VkBuffer &buffer, GpuAllocation &bufferMemory) {
+      vkDestroyBuffer(device, buffer, nullptr);
+      allocator->free(bufferMemory);
+      buffer = VK_NULL_HANDLE;
     }
 
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device) {
@@ -110,18 +110,34 @@ class VulkanDevice {
           resultIndices.graphicsFamily = i;
         }
 
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-        if (presentSupport) {
-          resultIndices.presentFamily = i;
+        if (!isHeadless()) {
+          VkBool32 presentSupport = false;
+          vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+          if (presentSupport) {
+            resultIndices.presentFamily = i;
+          }
         }
 
-        if (resultIndices.isComplete()) {
+        if (resultIndices.isComplete(!isHeadless())) {
           break;
         }
         i++;
       }
 
+      // Prefer a pure DMA family (no compute either), then any non-graphics transfer family.
+      for (uint32_t family = 0; family < queueFamilyCount; family++) {
+        VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+          continue;
+        }
+        if (!resultIndices.transferFamily.has_value() || !(flags & VK_QUEUE_COMPUTE_BIT)) {
+          resultIndices.transferFamily = family;
+        }
+        if (!(flags & VK_QUEUE_COMPUTE_BIT)) {
+          break;
+        }
+      }
+
       return resultIndices;
     }
 
@@ -138,26 +154,35 @@ class VulkanDevice {
 
       throw std::runtime_error("failed to find suitable memory type!");
     }
-    VulkanDevice(VkInstance instance, VkSurfaceKHR surface)
-      : instance(instance), surface(surface) {
+    // maxSamples caps the MSAA sample count; the device's highest usable count is used below it.
+    // VK_KHR_dynamic_rendering is only enabled when requestDynamicRendering asks for it.
+    VulkanDevice(VkInstance instance,
+                 VkSurfaceKHR surface,
+                 VkSampleCountFlagBits maxSamples = VK_SAMPLE_COUNT_64_BIT,
+                 bool requestDynamicRendering = false)
+      : instance(instance), surface(surface), maxSamples(maxSamples), dynamicRendering(requestDynamicRendering) {
       pickPhysicalDevice();
       createLogicalDevice();
+      loadTimelineFunctions();
+      loadDynamicRenderingFunctions();
+      allocator = std::make_unique<VulkanAllocator>(physicalDevice, device);
     }
 
     ~VulkanDevice() {
+      allocator.reset();
       if (device != VK_NULL_HANDLE) {
         vkDestroyDevice(device, nullptr);
       }
     }
 
-    static bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
+    static bool checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char *> &extensions) {
       uint32_t extensionCount;
       vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
       std::vector<VkExtensionProperties> availableExtensions(extensionCount);
       vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-      std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+      std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
       for (const auto &ext : availableExtensions) {
         requiredExtensions.erase(ext.extensionName);
       }
@@ -168,9 +193,164 @@ class VulkanDevice {
     [[nodiscard]] VkDevice getDevice() const { return device; }
     [[nodiscard]] VkQueue getGraphicsQueue() const { return graphicsQueue; }
     [[nodiscard]] VkQueue getPresentQueue() const { return presentQueue; }
+    // Dedicated transfer queue if the device has one, otherwise the graphics queue.
+    [[nodiscard]] VkQueue getTransferQueue() const {
+      return transferQueue != VK_NULL_HANDLE ? transferQueue : graphicsQueue;
+    }
     [[nodiscard]] VkSampleCountFlagBits getMsaaSamples() const { return msaaSamples; }
+    // multiDrawIndirect and drawIndirectFirstInstance are both enabled, so one indirect call can
+    // draw several ranges of the same instance buffer.
+    [[nodiscard]] bool supportsMultiDrawIndirect() const { return multiDrawIndirect; }
+    // VK_KHR_dynamic_rendering was requested, is supported and is enabled, so frames may render
+    // without VkRenderPass and VkFramebuffer objects through beginRendering and endRendering.
+    [[nodiscard]] bool supportsDynamicRendering() const { return dynamicRendering; }
+
+    void beginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR &renderingInfo) const {
+      cmdBeginRendering(commandBuffer, &renderingInfo);
+    }
+    void endRendering(VkCommandBuffer commandBuffer) const {
+      cmdEndRendering(commandBuffer);
+    }
 
     [[nodiscard]] QueueFamilyIndices getQueueFamilyIndices() const { return indices; }
+    [[nodiscard]] const GpuMemoryStats &getMemoryStats() const { return allocator->getStats(); }
+
+    // Created without a surface: no swapchain extension, no present queue.
+    [[nodiscard]] bool isHeadless() const { return surface == VK_NULL_HANDLE; }
+
+    // Frame pacing needs timeline semaphores everywhere; only presenting needs the swapchain.
+    [[nodiscard]] std::vector<const char *> getRequiredDeviceExtensions() const {
+      std::vector<const char *> extensions = {VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME};
+      if (!isHeadless()) {
+        extensions.insert(extensions.end(), deviceExtensions.begin(), deviceExtensions.end());
+      }
+      return extensions;
+    }
+
+    VkSemaphore createTimelineSemaphore(uint64_t initialValue = 0) const {
+      VkSemaphoreTypeCreateInfo typeInfo{};
+      typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+      typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+      typeInfo.initialValue = initialValue;
+
+      VkSemaphoreCreateInfo semaphoreInfo{};
+      semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      semaphoreInfo.pNext = &typeInfo;
+
+      VkSemaphore semaphore;
+      if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timeline semaphore!");
+      }
+      return semaphore;
+    }
+
+    [[nodiscard]] uint64_t getTimelineValue(VkSemaphore timeline) const {
+      uint64_t value = 0;
+      if (getSemaphoreCounterValue(device, timeline, &value) != VK_SUCCESS) {
+        throw std::runtime_error("failed to read timeline semaphore!");
+      }
+      return value;
+    }
+
+    // Blocks until the timeline reaches `value`; returns VK_TIMEOUT if it did not in time.
+    VkResult waitTimeline(VkSemaphore timeline, uint64_t value, uint64_t timeout = UINT64_MAX) const {
+      VkSemaphoreWaitInfo waitInfo{};
+      waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+      waitInfo.semaphoreCount = 1;
+      waitInfo.pSemaphores = &timeline;
+      waitInfo.pValues = &value;
+      VkResult result = waitSemaphores(device, &waitInfo, timeout);
+      if (result != VK_SUCCESS && result != VK_TIMEOUT) {
+        throw std::runtime_error("failed to wait for timeline semaphore!");
+      }
+      return result;
+    }
+
+    VkFormat findSupportedFormat(const std::vector<VkFormat> &candidates,
+                                 VkImageTiling tiling,
+                                 VkFormatFeatureFlags features) const {
+      for (VkFormat format : candidates) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+        if (tiling == VK_IMAGE_TILING_LINEAR &&
+          (props.linearTilingFeatures & features) == features) {
+          return format;
+        } else if (tiling == VK_IMAGE_TILING_OPTIMAL &&
+          (props.optimalTilingFeatures & features) == features) {
+          return format;
+        }
+      }
+      throw std::runtime_error("failed to find supported format!");
+    }
+
+    VkFormat findDepthFormat() const {
+      return findSupportedFormat(
+        {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+      );
+    }
+
+    void createImage(uint32_t w,
+                     uint32_t h,
+                     VkSampleCountFlagBits samples,
+                     VkFormat format,
+                     VkImageTiling tiling,
+                     VkImageUsageFlags usage,
+                     VkMemoryPropertyFlags properties,
+                     VkImage &image,
+                     GpuAllocation &imageMemory) {
+      VkImageCreateInfo imageInfo{};
+      imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+      imageInfo.imageType = VK_IMAGE_TYPE_2D;
+      imageInfo.extent.width = w;
+      imageInfo.extent.height = h;
+      imageInfo.extent.depth = 1;
+      imageInfo.mipLevels = 1;
+      imageInfo.arrayLayers = 1;
+      imageInfo.format = format;
+      imageInfo.tiling = tiling;
+      imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      imageInfo.usage = usage;
+      imageInfo.samples = samples;
+      imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+      if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
+      }
+
+      imageMemory = allocator->allocateForImage(image, tiling, properties);
+      vkBindImageMemory(device, image, imageMemory.memory, imageMemory.offset);
+    }
+
+    void destroyImage(VkImage &image, GpuAllocation &imageMemory) {
+      vkDestroyImage(device, image, nullptr);
+      allocator->free(imageMemory);
+      image = VK_NULL_HANDLE;
+    }
+
+    VkImageView createImageView(VkImage image,
+                                VkFormat format,
+                                VkImageAspectFlags aspectFlags,
+                                uint32_t mipLevels) const {
+      VkImageViewCreateInfo viewInfo{};
+      viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      viewInfo.image = image;
+      viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      viewInfo.format = format;
+      viewInfo.subresourceRange.aspectMask = aspectFlags;
+      viewInfo.subresourceRange.baseMipLevel = 0;
+      viewInfo.subresourceRange.levelCount = mipLevels;
+      viewInfo.subresourceRange.baseArrayLayer = 0;
+      viewInfo.subresourceRange.layerCount = 1;
+
+      VkImageView imageView;
+      if (vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture image view!");
+      }
+      return imageView;
+    }
 
   private:
     VkInstance instance = VK_NULL_HANDLE;
@@ -181,10 +361,30 @@ class VulkanDevice {
 
     VkQueue graphicsQueue = VK_NULL_HANDLE;
     VkQueue presentQueue = VK_NULL_HANDLE;
+    VkQueue transferQueue = VK_NULL_HANDLE;
 
     QueueFamilyIndices indices;
+    std::unique_ptr<VulkanAllocator> allocator;
 
+    VkSampleCountFlagBits maxSamples = VK_SAMPLE_COUNT_64_BIT;
     VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    bool multiDrawIndirect = false;
+    // Requested by the constructor, then cleared by createLogicalDevice if unsupported.
+    bool dynamicRendering = false;
+
+    // VK_KHR_timeline_semaphore entry points; the instance targets Vulkan 1.1, where they are not core.
+    PFN_vkWaitSemaphoresKHR waitSemaphores = nullptr;
+    PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue = nullptr;
+    // VK_KHR_dynamic_rendering entry points, loaded only when it is enabled.
+    PFN_vkCmdBeginRenderingKHR cmdBeginRendering = nullptr;
+    PFN_vkCmdEndRenderingKHR cmdEndRendering = nullptr;
+
+    // VK_KHR_dynamic_rendering and the extensions it builds on in Vulkan 1.1.
+    static std::vector<const char *> dynamicRenderingExtensions() {
+      return {VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+              VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
+              VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME};
+    }
 
     void pickPhysicalDevice() {
       uint32_t deviceCount = 0;
@@ -199,7 +399,7 @@ class VulkanDevice {
       for (const auto &candidate : devices) {
         if (isDeviceSuitable(candidate)) {
           physicalDevice = candidate;
-          msaaSamples = getMaxUsableSampleCount(candidate);
+          msaaSamples = std::min(getMaxUsableSampleCount(candidate), maxSamples);
           break;
         }
       }
@@ -212,25 +412,74 @@ class VulkanDevice {
     bool isDeviceSuitable(VkPhysicalDevice device) {
       QueueFamilyIndices indicesFound = findQueueFamilies(device);
 
-      bool extensionsSupported = checkDeviceExtensionSupport(device);
+      bool extensionsSupported = checkDeviceExtensionSupport(device, getRequiredDeviceExtensions());
 
-      bool swapChainAdequate = false;
-      if (extensionsSupported) {
+      bool swapChainAdequate = isHeadless();
+      if (extensionsSupported && !isHeadless()) {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
       }
 
-      return indicesFound.isComplete() && extensionsSupported && swapChainAdequate;
+      return indicesFound.isComplete(!isHeadless()) && extensionsSupported && swapChainAdequate
+             && supportsTimelineSemaphores(device);
+    }
+
+    static bool supportsTimelineSemaphores(VkPhysicalDevice device) {
+      VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+      timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+      VkPhysicalDeviceFeatures2 features{};
+      features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      features.pNext = &timelineFeatures;
+      vkGetPhysicalDeviceFeatures2(device, &features);
+      return timelineFeatures.timelineSemaphore == VK_TRUE;
+    }
+
+    static bool supportsDynamicRenderingFeature(VkPhysicalDevice device) {
+      if (!checkDeviceExtensionSupport(device, dynamicRenderingExtensions())) {
+        return false;
+      }
+      VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+      dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+      VkPhysicalDeviceFeatures2 features{};
+      features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      features.pNext = &dynamicRenderingFeatures;
+      vkGetPhysicalDeviceFeatures2(device, &features);
+      return dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+    }
+
+    void loadDynamicRenderingFunctions() {
+      if (!dynamicRendering) {
+        return;
+      }
+      cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+        vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
+      cmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+        vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
+      if (cmdBeginRendering == nullptr || cmdEndRendering == nullptr) {
+        throw std::runtime_error("failed to load dynamic rendering functions!");
+      }
+    }
+
+    void loadTimelineFunctions() {
+      waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR"));
+      getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+        vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR"));
+      if (waitSemaphores == nullptr || getSemaphoreCounterValue == nullptr) {
+        throw std::runtime_error("failed to load timeline semaphore functions!");
+      }
     }
 
     void createLogicalDevice() {
       indices = findQueueFamilies(physicalDevice);
 
       std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-      std::set<uint32_t> uniqueQueueFamilies = {
-        indices.graphicsFamily.value(),
-        indices.presentFamily.value()
-      };
+      std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value()};
+      if (indices.presentFamily.has_value()) {
+        uniqueQueueFamilies.insert(indices.presentFamily.value());
+      }
+      if (indices.transferFamily.has_value()) {
+        uniqueQueueFamilies.insert(indices.transferFamily.value());
+      }
 
       float queuePriority = 1.0f;
       for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -242,15 +491,41 @@ class VulkanDevice {
         queueCreateInfos.push_back(queueCreateInfo);
       }
 
+      // Optional: without them every indirect command is drawn on its own.
+      VkPhysicalDeviceFeatures supportedFeatures;
+      vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+      multiDrawIndirect = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+
       VkPhysicalDeviceFeatures deviceFeatures{};
+      deviceFeatures.multiDrawIndirect = multiDrawIndirect ? VK_TRUE : VK_FALSE;
+      deviceFeatures.drawIndirectFirstInstance = multiDrawIndirect ? VK_TRUE : VK_FALSE;
+      VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+      timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+      timelineFeatures.timelineSemaphore = VK_TRUE;
+
+      // Optional too, and only when requested: without it frames go through a VkRenderPass and
+      // framebuffers.
+      dynamicRendering = dynamicRendering && supportsDynamicRenderingFeature(physicalDevice);
+      VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+      dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+      dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+      if (dynamicRendering) {
+        timelineFeatures.pNext = &dynamicRenderingFeatures;
+      }
 
       VkDeviceCreateInfo createInfo{};
       createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+      createInfo.pNext = &timelineFeatures;
       createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
       createInfo.pQueueCreateInfos = queueCreateInfos.data();
       createInfo.pEnabledFeatures = &deviceFeatures;
-      createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-      createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+      auto extensions = getRequiredDeviceExtensions();
+      if (dynamicRendering) {
+        auto optional = dynamicRenderingExtensions();
+        extensions.insert(extensions.end(), optional.begin(), optional.end());
+      }
+      createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+      createInfo.ppEnabledExtensionNames = extensions.data();
 
       if (enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -264,7 +539,12 @@ class VulkanDevice {
       }
 
       vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
-      vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+      if (indices.presentFamily.has_value()) {
+        vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+      }
+      if (indices.transferFamily.has_value()) {
+        vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+      }
     }
 
     static VkSampleCountFlagBits getMaxUsableSampleCount(VkPhysicalDevice device) {
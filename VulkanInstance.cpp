@@ -45,10 +45,13 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance,
 
 class VulkanInstance {
   public:
+    // A null window creates a headless instance with no surface.
     explicit VulkanInstance(GLFWwindow *window) : window(window) {
       createInstance();
       setupDebugMessenger();
-      createSurface();
+      if (window != nullptr) {
+        createSurface();
+      }
     }
 
     ~VulkanInstance() {
@@ -83,13 +86,13 @@ class VulkanInstance {
       appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
       appInfo.pEngineName = "No Engine";
       appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-      appInfo.apiVersion = VK_API_VERSION_1_0;
+      appInfo.apiVersion = VK_API_VERSION_1_1;
 
       VkInstanceCreateInfo createInfo{};
       createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
       createInfo.pApplicationInfo = &appInfo;
 
-      auto extensions = getRequiredExtensions();
+      auto extensions = getRequiredExtensions(window != nullptr);
       if (macOS) {
         extensions.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
         createInfo.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
@@ -169,12 +172,15 @@ class VulkanInstance {
       return true;
     }
 
-    static std::vector<const char *> getRequiredExtensions() {
-      uint32_t glfwExtensionCount = 0;
-      const char **glfwExtensions;
-      glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    static std::vector<const char *> getRequiredExtensions(bool needsSurface) {
+      std::vector<const char *> extensions;
 
-      std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+      if (needsSurface) {
+        uint32_t glfwExtensionCount = 0;
+        const char **glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+      }
 
       if (enableValidationLayers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -0,0 +1,280 @@
+//
+// Created by Elijah Crain on 10/17/26.
+//
+#pragma once
+
+#include "VulkanDevice.cpp"
+#include "VulkanSync.cpp"
+#include <vector>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <memory>
+#include <optional>
+
+// Headless stand-in for VulkanSwapChain: a small ring of offscreen color targets that
+// drawFrame renders into instead of swapchain images. The ring is bounded, so the CPU
+// only blocks when every target is still in flight; there is no presentation limit.
+class VulkanOffscreenTargets {
+  public:
+    VulkanOffscreenTargets(std::shared_ptr<VulkanDevice> device,
+                           uint32_t width,
+                           uint32_t height,
+                           uint32_t targetCount,
+                           VkFormat imageFormat = VK_FORMAT_R8G8B8A8_UNORM)
+      : devicePtr(device), imageFormat(imageFormat), extent{width, height} {
+      targets.resize(targetCount);
+      createTargetImages();
+      createColorResources();
+      createDepthResources();
+    }
+
+    ~VulkanOffscreenTargets() {
+      for (auto &target : targets) {
+        vkDestroyFramebuffer(device(), target.framebuffer, nullptr);
+        vkDestroyImageView(device(), target.imageView, nullptr);
+        devicePtr->destroyImage(target.image, target.imageMemory);
+      }
+
+      vkDestroyImageView(device(), depthImageView, nullptr);
+      devicePtr->destroyImage(depthImage, depthImageMemory);
+
+      vkDestroyImageView(device(), colorImageView, nullptr);
+      devicePtr->destroyImage(colorImage, colorImageMemory);
+    }
+
+    void createFramebuffers(VkRenderPass renderPass) {
+      for (auto &target : targets) {
+        std::vector<VkImageView> attachments;
+        if (devicePtr->getMsaaSamples() == VK_SAMPLE_COUNT_1_BIT) {
+          attachments = {target.imageView, depthImageView};
+        } else {
+          attachments = {colorImageView, depthImageView, target.imageView};
+        }
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        framebufferInfo.pAttachments = attachments.data();
+        framebufferInfo.width = extent.width;
+        framebufferInfo.height = extent.height;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(device(), &framebufferInfo, nullptr, &target.framebuffer) != VK_SUCCESS) {
+          throw std::runtime_error("failed to create offscreen framebuffer!");
+        }
+      }
+    }
+
+    // Returns the next target in the ring for frameNumber, waiting only if an earlier frame is
+    // still rendering into it.
+    uint32_t acquireNextTarget(uint64_t frameNumber, const VulkanSync &sync) {
+      uint32_t index = nextTarget;
+      Target &target = targets[index];
+
+      if (target.lastFrame) {
+        sync.waitForFrame(*target.lastFrame);
+      }
+      target.lastFrame = frameNumber;
+
+      nextTarget = (nextTarget + 1) % static_cast<uint32_t>(targets.size());
+      return index;
+    }
+
+    // Copies a finished target into host memory as tightly packed rows of imageFormat texels.
+    std::vector<uint8_t> readback(uint32_t index, VkCommandPool commandPool, VkQueue queue, const VulkanSync &sync) {
+      Target &target = targets[index];
+      if (target.lastFrame) {
+        sync.waitForFrame(*target.lastFrame);
+      }
+
+      VkDeviceSize bufferSize = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+      VkBuffer stagingBuffer;
+      GpuAllocation stagingBufferMemory;
+      devicePtr->createBuffer(bufferSize,
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              stagingBuffer,
+                              stagingBufferMemory);
+
+      VkCommandBufferAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocInfo.commandPool = commandPool;
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+      allocInfo.commandBufferCount = 1;
+
+      VkCommandBuffer commandBuffer;
+      if (vkAllocateCommandBuffers(device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate readback command buffer!");
+      }
+
+      VkCommandBufferBeginInfo beginInfo{};
+      beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+      vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+      // Frames leave the target in TRANSFER_SRC_OPTIMAL; only the write needs ordering.
+      VkImageMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+      barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = target.image;
+      barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      barrier.subresourceRange.levelCount = 1;
+      barrier.subresourceRange.layerCount = 1;
+      vkCmdPipelineBarrier(commandBuffer,
+                           VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           0,
+                           0, nullptr,
+                           0, nullptr,
+                           1, &barrier);
+
+      VkBufferImageCopy region{};
+      region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      region.imageSubresource.layerCount = 1;
+      region.imageExtent = {extent.width, extent.height, 1};
+      vkCmdCopyImageToBuffer(commandBuffer,
+                             target.image,
+                             VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                             stagingBuffer,
+                             1,
+                             &region);
+
+      VkBufferMemoryBarrier hostBarrier{};
+      hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+      hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+      hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      hostBarrier.buffer = stagingBuffer;
+      hostBarrier.size = VK_WHOLE_SIZE;
+      vkCmdPipelineBarrier(commandBuffer,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_PIPELINE_STAGE_HOST_BIT,
+                           0,
+                           0, nullptr,
+                           1, &hostBarrier,
+                           0, nullptr);
+
+      vkEndCommandBuffer(commandBuffer);
+
+      VkSubmitInfo submitInfo{};
+      submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      submitInfo.commandBufferCount = 1;
+      submitInfo.pCommandBuffers = &commandBuffer;
+      if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit readback command buffer!");
+      }
+      vkQueueWaitIdle(queue);
+      vkFreeCommandBuffers(device(), commandPool, 1, &commandBuffer);
+
+      std::vector<uint8_t> pixels(bufferSize);
+      memcpy(pixels.data(), stagingBufferMemory.mapped, (size_t) bufferSize);
+
+      devicePtr->destroyBuffer(stagingBuffer, stagingBufferMemory);
+      return pixels;
+    }
+
+    VkFormat getImageFormat() const { return imageFormat; }
+    VkExtent2D getExtent() const { return extent; }
+    uint32_t getTargetCount() const { return static_cast<uint32_t>(targets.size()); }
+    VkFramebuffer getFramebuffer(uint32_t index) const { return targets[index].framebuffer; }
+    VkImage getImage(uint32_t index) const { return targets[index].image; }
+    VkImageView getImageView(uint32_t index) const { return targets[index].imageView; }
+
+    VkImage getDepthImage() const { return depthImage; }
+    VkImageView getDepthImageView() const { return depthImageView; }
+    VkImage getColorImage() const { return colorImage; }
+    VkImageView getColorImageView() const { return colorImageView; }
+
+  private:
+    struct Target {
+      VkImage image = VK_NULL_HANDLE;
+      GpuAllocation imageMemory;
+      VkImageView imageView = VK_NULL_HANDLE;
+      VkFramebuffer framebuffer = VK_NULL_HANDLE;
+      // Frame that last rendered into the target, if any.
+      std::optional<uint64_t> lastFrame;
+    };
+
+    std::shared_ptr<VulkanDevice> devicePtr;
+    VkFormat imageFormat;
+    VkExtent2D extent;
+
+    std::vector<Target> targets;
+    uint32_t nextTarget = 0;
+
+    VkImage depthImage = VK_NULL_HANDLE;
+    GpuAllocation depthImageMemory;
+    VkImageView depthImageView = VK_NULL_HANDLE;
+
+    VkImage colorImage = VK_NULL_HANDLE;
+    GpuAllocation colorImageMemory;
+    VkImageView colorImageView = VK_NULL_HANDLE;
+
+    VkDevice device() const { return devicePtr->getDevice(); }
+
+    void createTargetImages() {
+      for (auto &target : targets) {
+        devicePtr->createImage(extent.width,
+                               extent.height,
+                               VK_SAMPLE_COUNT_1_BIT,
+                               imageFormat,
+                               VK_IMAGE_TILING_OPTIMAL,
+                               VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                               target.image,
+                               target.imageMemory);
+
+        target.imageView = devicePtr->createImageView(target.image,
+                                                      imageFormat,
+                                                      VK_IMAGE_ASPECT_COLOR_BIT,
+                                                      1 /*mipLevels*/);
+      }
+    }
+
+    void createColorResources() {
+      if (devicePtr->getMsaaSamples() == VK_SAMPLE_COUNT_1_BIT) {
+        return;
+      }
+
+      devicePtr->createImage(extent.width,
+                             extent.height,
+                             devicePtr->getMsaaSamples(),
+                             imageFormat,
+                             VK_IMAGE_TILING_OPTIMAL,
+                             VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             colorImage,
+                             colorImageMemory);
+
+      colorImageView = devicePtr->createImageView(colorImage,
+                                                  imageFormat,
+                                                  VK_IMAGE_ASPECT_COLOR_BIT,
+                                                  1 /*mipLevels*/);
+    }
+
+    void createDepthResources() {
+      VkFormat depthFormat = devicePtr->findDepthFormat();
+      devicePtr->createImage(extent.width,
+                             extent.height,
+                             devicePtr->getMsaaSamples(),
+                             depthFormat,
+                             VK_IMAGE_TILING_OPTIMAL,
+                             VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             depthImage,
+                             depthImageMemory);
+
+      depthImageView = devicePtr->createImageView(depthImage,
+                                                  depthFormat,
+                                                  VK_IMAGE_ASPECT_DEPTH_BIT,
+                                                  1 /*mipLevels*/);
+    }
+};
@@ -4,26 +4,49 @@
 #pragma once
 
 #include "VulkanDevice.cpp"
+#include "ShaderLibrary.cpp"
 #include <vector>
-#include <string>
 #include <stdexcept>
-#include <fstream>
 #include <array>
+#include <glm/glm.hpp>
 #include "Util.cpp"
 
+// Vertex-stage push constants of the graphics pipeline; must match the block in shader.vert.
+// proj * view is multiplied once per frame on the CPU instead of once per vertex. Pipelines built
+// from ShaderId::VertexCameraUniform read the same struct from uniform block 0 of the descriptor
+// set instead, so command buffers recorded once still see each frame's camera.
+struct CameraPushConstants {
+  glm::mat4 viewProj;
+};
+
+// What the graphics pipeline renders into: a render pass, or with dynamic rendering (null
+// renderPass) the attachment formats it is created against instead.
+struct PipelineTarget {
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+  VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+  VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+
+  [[nodiscard]] bool sameFormats(const PipelineTarget &other) const {
+    return colorFormat == other.colorFormat && depthFormat == other.depthFormat;
+  }
+};
+
 class VulkanPipeline {
   public:
     VulkanPipeline(
       VkDevice device,
-      VkRenderPass renderPass,
+      VkPipelineCache pipelineCache,
+      const PipelineTarget &target,
       VkDescriptorSetLayout descriptorSetLayout,
       VkSampleCountFlagBits msaaSamples,
-      const std::string &vertShaderPath,
-      const std::string &fragShaderPath
+      const SpirvCode &vertShader,
+      const SpirvCode &fragShader,
+      VertexFormat vertexFormat = VertexFormat::Compact
     )
-      : device(device) {
+      : device(device), pipelineCache(pipelineCache), vertexFormat(vertexFormat) {
       createPipelineLayout(descriptorSetLayout);
-      createGraphicsPipeline(renderPass, msaaSamples, vertShaderPath, fragShaderPath);
+      pipeline = createGraphicsPipeline(target, msaaSamples, vertShader, fragShader);
+      this->target = target;
     }
 
     ~VulkanPipeline() {
@@ -35,17 +58,41 @@ class VulkanPipeline {
       }
     }
 
-    void createGraphicsPipeline(
-      VkRenderPass renderPass,
+    // Swaps in a new pipeline and returns the old one, which frames already recorded may still
+    // use; the caller destroys it once they have finished. The old one is kept if creation fails.
+    [[nodiscard]] VkPipeline recreateGraphicsPipeline(
+      const PipelineTarget &target,
       VkSampleCountFlagBits msaaSamples,
-      const std::string &vertShaderPath,
-      const std::string &fragShaderPath
+      const SpirvCode &vertShader,
+      const SpirvCode &fragShader
     ) {
-      auto vertShaderCode = readFile(vertShaderPath);
-      auto fragShaderCode = readFile(fragShaderPath);
+      VkPipeline previous = pipeline;
+      pipeline = createGraphicsPipeline(target, msaaSamples, vertShader, fragShader);
+      this->target = target;
+      return previous;
+    }
 
-      VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-      VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+    VkPipeline getPipeline() const { return pipeline; }
+    VkPipelineLayout getLayout() const { return pipelineLayout; }
+    // The target the current pipeline was created against.
+    [[nodiscard]] const PipelineTarget &getTarget() const { return target; }
+
+  private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    PipelineTarget target;
+    VertexFormat vertexFormat;
+
+    VkPipeline createGraphicsPipeline(
+      const PipelineTarget &target,
+      VkSampleCountFlagBits msaaSamples,
+      const SpirvCode &vertShader,
+      const SpirvCode &fragShader
+    ) {
+      VkShaderModule vertShaderModule = createShaderModule(vertShader);
+      VkShaderModule fragShaderModule = createShaderModule(fragShader);
 
       VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
       vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -62,12 +109,12 @@ class VulkanPipeline {
       VkPipelineShaderStageCreateInfo shaderStages[] = {
         vertShaderStageInfo, fragShaderStageInfo
       };
-      auto bindingDescription = Vertex::getBindingDescription();
-      auto instanceBindingDescription = Vertex::getInstanceBindingDescription();
+      auto bindingDescription = Vertex::getBindingDescription(vertexFormat);
+      auto instanceBindingDescription = Vertex::getInstanceBindingDescription(vertexFormat);
       std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = {
         bindingDescription, instanceBindingDescription
       };
-      auto attributeDescriptions = Vertex::getAttributeDescriptions();
+      auto attributeDescriptions = Vertex::getAttributeDescriptions(vertexFormat);
 
       VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
       vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -148,55 +195,53 @@ class VulkanPipeline {
       pipelineInfo.pColorBlendState = &colorBlending;
       pipelineInfo.pDynamicState = &dynamicState;
       pipelineInfo.layout = pipelineLayout;
-      pipelineInfo.renderPass = renderPass;
+      pipelineInfo.renderPass = target.renderPass;
       pipelineInfo.subpass = 0;
 
-      if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline!");
+      // Dynamic rendering only names the formats. The depth view has no stencil aspect, so no
+      // stencil attachment is bound even when the depth format carries one.
+      VkPipelineRenderingCreateInfoKHR renderingInfo{};
+      renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+      renderingInfo.colorAttachmentCount = 1;
+      renderingInfo.pColorAttachmentFormats = &target.colorFormat;
+      renderingInfo.depthAttachmentFormat = target.depthFormat;
+      renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+      if (target.renderPass == VK_NULL_HANDLE) {
+        pipelineInfo.pNext = &renderingInfo;
       }
 
+      VkPipeline newPipeline;
+      VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &newPipeline);
       vkDestroyShaderModule(device, fragShaderModule, nullptr);
       vkDestroyShaderModule(device, vertShaderModule, nullptr);
+      if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+      }
+      return newPipeline;
     }
 
-    VkPipeline getPipeline() const { return pipeline; }
-    VkPipelineLayout getLayout() const { return pipelineLayout; }
-
-  private:
-    VkDevice device = VK_NULL_HANDLE;
-    VkPipeline pipeline = VK_NULL_HANDLE;
-    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
-
     void createPipelineLayout(VkDescriptorSetLayout descriptorSetLayout) {
       VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
       pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
       pipelineLayoutInfo.setLayoutCount = 1;
       pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-      pipelineLayoutInfo.pushConstantRangeCount = 0;
+      VkPushConstantRange pushConstantRange{};
+      pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+      pushConstantRange.offset = 0;
+      pushConstantRange.size = sizeof(CameraPushConstants);
+      pipelineLayoutInfo.pushConstantRangeCount = 1;
+      pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
       if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create pipeline layout!");
       }
     }
 
-    static std::vector<char> readFile(const std::string &filename) {
-      std::ifstream file(filename, std::ios::ate | std::ios::binary);
-      if (!file.is_open()) {
-        throw std::runtime_error("failed to open file!");
-      }
-      size_t fileSize = (size_t) file.tellg();
-      std::vector<char> buffer(fileSize);
-      file.seekg(0);
-      file.read(buffer.data(), fileSize);
-      file.close();
-      return buffer;
-    }
-
-    VkShaderModule createShaderModule(const std::vector<char> &code) {
+    VkShaderModule createShaderModule(const SpirvCode &code) {
       VkShaderModuleCreateInfo createInfo{};
       createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-      createInfo.codeSize = code.size();
-      createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+      createInfo.codeSize = code.size() * sizeof(uint32_t);
+      createInfo.pCode = code.data();
 
       VkShaderModule shaderModule;
       if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
@@ -0,0 +1,161 @@
+//
+// Created by Elijah Crain on 10/17/26.
+//
+#pragma once
+
+#include "VulkanDevice.cpp"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <memory>
+#include <iostream>
+#include <cstdlib>
+
+// Where the pipeline cache lives unless the caller picks a file: the per-user cache directory
+// (%LOCALAPPDATA% on Windows, ~/Library/Caches on macOS, $XDG_CACHE_HOME or ~/.cache elsewhere),
+// so it neither depends on the working directory nor lands next to the user's files. Empty, and
+// so kept in memory, when none of those can be found.
+inline std::string defaultPipelineCachePath() {
+  auto env = [](const char *name) -> std::filesystem::path {
+    const char *value = std::getenv(name);
+    return value != nullptr && value[0] != '\0' ? std::filesystem::path(value) : std::filesystem::path();
+  };
+#if defined(_WIN32)
+  std::filesystem::path base = env("LOCALAPPDATA");
+#elif defined(__APPLE__)
+  std::filesystem::path base = env("HOME").empty() ? std::filesystem::path() : env("HOME") / "Library" / "Caches";
+#else
+  std::filesystem::path base = env("XDG_CACHE_HOME");
+  if (base.empty() && !env("HOME").empty()) {
+    base = env("HOME") / ".cache";
+  }
+#endif
+  if (base.empty()) {
+    return {};
+  }
+  return (base / "VulkanMagnets" / "pipeline_cache.bin").string();
+}
+
+// One VkPipelineCache shared by every pipeline the renderer creates, persisted to disk between
+// runs so startup and swapchain recreation skip shader compilation the driver has already done.
+// A file written by another driver or device is ignored rather than handed to the driver.
+class VulkanPipelineCache {
+  public:
+    // An empty path keeps the cache in memory only.
+    VulkanPipelineCache(std::shared_ptr<VulkanDevice> device, std::string path)
+      : devicePtr(std::move(device)), path(std::move(path)) {
+      std::vector<char> initialData = loadFile();
+
+      VkPipelineCacheCreateInfo cacheInfo{};
+      cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+      cacheInfo.initialDataSize = initialData.size();
+      cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+      if (vkCreatePipelineCache(devicePtr->getDevice(), &cacheInfo, nullptr, &cache) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache!");
+      }
+      loadedBytes = initialData.size();
+    }
+
+    ~VulkanPipelineCache() {
+      if (cache != VK_NULL_HANDLE) {
+        vkDestroyPipelineCache(device(), cache, nullptr);
+      }
+    }
+
+    VulkanPipelineCache(const VulkanPipelineCache &) = delete;
+    VulkanPipelineCache &operator=(const VulkanPipelineCache &) = delete;
+
+    // Writes the cache next to its final path and renames it into place, so a crash mid-write
+    // never leaves a truncated file for the next start to load. Creates the directory if it is
+    // missing. Returns false if nothing was written.
+    bool save() const {
+      if (path.empty()) {
+        return false;
+      }
+      size_t size = 0;
+      if (vkGetPipelineCacheData(device(), cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+        return false;
+      }
+      std::vector<char> data(size);
+      if (vkGetPipelineCacheData(device(), cache, &size, data.data()) != VK_SUCCESS) {
+        return false;
+      }
+
+      std::error_code error;
+      std::filesystem::path parent = std::filesystem::path(path).parent_path();
+      if (!parent.empty()) {
+        std::filesystem::create_directories(parent, error);
+        if (error) {
+          return false;
+        }
+      }
+      std::string tempPath = path + ".tmp";
+      {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+          return false;
+        }
+        file.write(data.data(), static_cast<std::streamsize>(size));
+        if (!file) {
+          return false;
+        }
+      }
+      std::filesystem::rename(tempPath, path, error);
+      if (error) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+      }
+      return true;
+    }
+
+    [[nodiscard]] VkPipelineCache getHandle() const { return cache; }
+    // Size of the data the cache was seeded with; 0 on a cold start.
+    [[nodiscard]] size_t getLoadedBytes() const { return loadedBytes; }
+
+  private:
+    std::shared_ptr<VulkanDevice> devicePtr;
+    std::string path;
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    size_t loadedBytes = 0;
+
+    VkDevice device() const { return devicePtr->getDevice(); }
+
+    // The file's contents if its header matches this device and driver, otherwise nothing.
+    std::vector<char> loadFile() const {
+      if (path.empty()) {
+        return {};
+      }
+      std::ifstream file(path, std::ios::ate | std::ios::binary);
+      if (!file.is_open()) {
+        return {};
+      }
+      auto size = static_cast<size_t>(file.tellg());
+      if (size < sizeof(VkPipelineCacheHeaderVersionOne)) {
+        return {};
+      }
+      std::vector<char> data(size);
+      file.seekg(0);
+      file.read(data.data(), static_cast<std::streamsize>(size));
+      if (!file) {
+        return {};
+      }
+
+      VkPipelineCacheHeaderVersionOne header;
+      std::memcpy(&header, data.data(), sizeof(header));
+      VkPhysicalDeviceProperties props;
+      vkGetPhysicalDeviceProperties(devicePtr->getPhysicalDevice(), &props);
+      if (header.headerSize < sizeof(header)
+          || header.headerSize > size
+          || header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+          || header.vendorID != props.vendorID
+          || header.deviceID != props.deviceID
+          || std::memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        std::cerr << "ignoring pipeline cache " << path << " from another device or driver" << std::endl;
+        return {};
+      }
+      return data;
+    }
+};
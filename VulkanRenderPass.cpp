@@ -5,6 +5,7 @@
 
 #include "VulkanDevice.cpp"
 #include <array>
+#include <vector>
 #include <stdexcept>
 #include <memory>
 
@@ -13,8 +14,9 @@ class VulkanRenderPass {
     VulkanRenderPass(std::shared_ptr<VulkanDevice> device,
                      VkFormat swapChainImageFormat,
                      VkSampleCountFlagBits msaaSamples,
-                     VkFormat depthFormat)
-      : devicePtr(device) {
+                     VkFormat depthFormat,
+                     VkImageLayout finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
+      : devicePtr(device), finalLayout(finalLayout) {
       createRenderPass(swapChainImageFormat, msaaSamples, depthFormat);
     }
 
@@ -24,6 +26,7 @@ class VulkanRenderPass {
       }
     }
 
+    // Replaces the render pass; the caller must make sure the old one is no longer in use.
     void createRenderPass(VkFormat swapChainImageFormat,
                           VkSampleCountFlagBits msaaSamples,
                           VkFormat depthFormat) {
@@ -35,7 +38,10 @@ class VulkanRenderPass {
       colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
       colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
       colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-      colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+      // Without MSAA the color attachment is the swapchain/offscreen image itself, so it goes
+      // straight to finalLayout and there is no resolve attachment.
+      const bool resolve = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+      colorAttachment.finalLayout = resolve ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : finalLayout;
 
       VkAttachmentDescription depthAttachment{};
       depthAttachment.format = depthFormat;
@@ -55,7 +61,7 @@ class VulkanRenderPass {
       colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
       colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
       colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-      colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+      colorAttachmentResolve.finalLayout = finalLayout;
 
       VkAttachmentReference colorAttachmentRef{};
       colorAttachmentRef.attachment = 0;
@@ -73,7 +79,7 @@ class VulkanRenderPass {
       subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
       subpass.colorAttachmentCount = 1;
       subpass.pColorAttachments = &colorAttachmentRef;
-      subpass.pResolveAttachments = &colorAttachmentResolveRef;
+      subpass.pResolveAttachments = resolve ? &colorAttachmentResolveRef : nullptr;
       subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
       VkSubpassDependency dependency{};
@@ -88,9 +94,10 @@ class VulkanRenderPass {
       dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
       dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
-      std::array<VkAttachmentDescription, 3> attachments = {
-        colorAttachment, depthAttachment, colorAttachmentResolve
-      };
+      std::vector<VkAttachmentDescription> attachments = {colorAttachment, depthAttachment};
+      if (resolve) {
+        attachments.push_back(colorAttachmentResolve);
+      }
 
       VkRenderPassCreateInfo renderPassInfo{};
       renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -101,15 +108,39 @@ class VulkanRenderPass {
       renderPassInfo.dependencyCount = 1;
       renderPassInfo.pDependencies = &dependency;
 
-      if (vkCreateRenderPass(devicePtr->getDevice(), &renderPassInfo, nullptr, &renderPass)
+      VkRenderPass newRenderPass;
+      if (vkCreateRenderPass(devicePtr->getDevice(), &renderPassInfo, nullptr, &newRenderPass)
         != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
       }
+      if (renderPass != VK_NULL_HANDLE) {
+        vkDestroyRenderPass(devicePtr->getDevice(), renderPass, nullptr);
+      }
+      renderPass = newRenderPass;
+      colorFormat = swapChainImageFormat;
+      samples = msaaSamples;
+      this->depthFormat = depthFormat;
+    }
+
+    // Whether framebuffers with these attachments can keep using this render pass (and every
+    // pipeline built against it). Extent is not part of a render pass, so a resize alone never
+    // needs a new one.
+    [[nodiscard]] bool matches(VkFormat swapChainImageFormat,
+                               VkSampleCountFlagBits msaaSamples,
+                               VkFormat depthFormat) const {
+      return renderPass != VK_NULL_HANDLE
+             && colorFormat == swapChainImageFormat
+             && samples == msaaSamples
+             && this->depthFormat == depthFormat;
     }
 
     VkRenderPass getHandle() const { return renderPass; }
 
   private:
     std::shared_ptr<VulkanDevice> devicePtr;
+    VkImageLayout finalLayout;
     VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
 };
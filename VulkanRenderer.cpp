@@ -7,11 +7,22 @@
 #include "VulkanInstance.cpp"
 #include "VulkanDevice.cpp"
 #include "VulkanSwapChain.cpp"
+#include "VulkanOffscreen.cpp"
 #include "VulkanRenderPass.cpp"
 #include "VulkanPipeline.cpp"
+#include "VulkanPipelineCache.cpp"
+#include "VulkanDeletionQueue.cpp"
 #include "VulkanDescriptor.cpp"
 #include "VulkanCommands.cpp"
 #include "VulkanSync.cpp"
+#include "VulkanTimestamps.cpp"
+#include "VulkanUpload.cpp"
+#include "VulkanCulling.cpp"
+#include "VulkanSimulation.cpp"
+#include "CpuMagnetSolver.cpp"
+#include "InstanceStore.cpp"
+#include "ShaderLibrary.cpp"
+#include "MeshOptimizer.cpp"
 
 #include "Util.cpp"
 #include <glm/glm.hpp>
@@ -20,6 +31,127 @@
 #include <stdexcept>
 #include <array>
 #include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+// Where the magnet lattice is integrated, if anywhere.
+enum class MagnetBackend {
+  None,
+  Gpu,  // compute pass at the start of each frame
+  Cpu   // CpuMagnetSolver, packed into the instance buffers once per frame
+};
+
+struct RendererConfig {
+  int gridWidth = 10;
+  int gridHeight = 10;
+  // Upper bound on MSAA samples; the device's highest supported count below it is used.
+  VkSampleCountFlagBits maxMsaaSamples = VK_SAMPLE_COUNT_64_BIT;
+  // Number of frames of GPU timestamp results kept for getGpuTimestamps().
+  size_t gpuTimingHistory = 256;
+  // Frustum-cull instances in a compute pass and draw the survivors indirectly.
+  bool gpuCulling = true;
+  // Smallest projected hex diameter, in pixels, drawn at LOD 0 and at LOD 1; smaller hexes use
+  // the flat LOD 2. Zeros keep every hex at full detail. LODs are picked by the cull pass, so
+  // without gpuCulling everything is drawn at LOD 0.
+  std::array<float, 2> lodScreenSizes = {48.0f, 12.0f};
+  MagnetBackend magnetBackend = MagnetBackend::Gpu;
+  MagnetSimulationConfig magnets{};
+  // Threads of the CPU backend, 0 for one per hardware thread.
+  uint32_t cpuSolverThreads = 0;
+  // Pipeline cache file, loaded at init and rewritten by cleanup; by default in the per-user
+  // cache directory, see defaultPipelineCachePath. Empty keeps it in memory.
+  std::string pipelineCachePath = defaultPipelineCachePath();
+  // Threads recording the indirect draws into secondary command buffers, 0 for one per hardware
+  // thread, capped at one per draw job. With 1, or with multi-draw indirect, where all draws are
+  // one job, everything is recorded inline into the frame's primary buffer.
+  uint32_t recordingThreads = 1;
+  // Present mode, swapchain depth and default frames in flight; see PresentProfile.
+  PresentProfile presentProfile = PresentProfile::Balanced;
+  // Frames the CPU may record ahead of the GPU, 0 for the present profile's choice. More hides
+  // GPU hiccups at the cost of latency and one more copy of every per-frame resource.
+  uint32_t framesInFlight = 0;
+  // Development mode: watch the GLSL in shaders/, recompile edits with glslc in the background
+  // and swap the affected pipelines in between frames.
+  bool shaderHotReload = false;
+  // Layout of the vertex and instance buffers; Full keeps 32-bit floats for comparison.
+  VertexFormat vertexFormat = VertexFormat::Compact;
+  // Weld and reorder the generated hex meshes at startup for vertex cache reuse and fetch
+  // locality; see getMeshReports() for the effect.
+  bool optimizeMeshes = true;
+  // Record one command buffer per frame slot and render target once and resubmit it for as long
+  // as nothing but the camera changes, which then comes from memory the GPU reads at execution
+  // time. Frames that upload instance edits, and every frame with a simulation backend, are
+  // still recorded as usual. Geometry, grid, swapchain and shader changes re-record.
+  bool staticCommandBuffers = false;
+  // Render with VK_KHR_dynamic_rendering straight into the swapchain (or offscreen), MSAA and
+  // depth views, with explicit layout barriers, instead of through a VkRenderPass and one
+  // VkFramebuffer per image. Resizes then only rebuild the images. Ignored where the device
+  // lacks the extension.
+  bool dynamicRendering = false;
+};
+
+// Hex variants, in the order their instances are laid out. Edge hexes also draw their side
+// panels; any further shape gets its own entry and meshes.
+enum HexVariant : uint32_t {
+  EDGE_HEX = 0,
+  INTERNAL_HEX,
+  HEX_VARIANT_COUNT
+};
+
+// Every LOD of every hex variant in one device-local vertex buffer and one index buffer, so the
+// whole lattice draws from a single set of bindings.
+struct HexGeometry {
+  VkBuffer vertexBuffer = VK_NULL_HANDLE;
+  GpuAllocation vertexMemory;
+  VkBuffer indexBuffer = VK_NULL_HANDLE;
+  GpuAllocation indexMemory;
+  VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+  // [variant][lod], most detailed first.
+  std::array<std::array<MeshRange, CULL_LOD_COUNT>, HEX_VARIANT_COUNT> meshes{};
+  // Vertex cache figures of each mesh before and after optimizeMesh; before == after when the
+  // optimizer is off.
+  std::array<std::array<MeshOptimizationReport, CULL_LOD_COUNT>, HEX_VARIANT_COUNT> reports{};
+};
+
+// What one frame renders into: the framebuffer on the render pass path; with dynamic
+// rendering the image the frame ends up in, the multisampled color image resolved into it (null
+// without MSAA) and the depth image, each with its view.
+struct RenderTarget {
+  VkFramebuffer framebuffer = VK_NULL_HANDLE;
+  VkImage image = VK_NULL_HANDLE;
+  VkImageView imageView = VK_NULL_HANDLE;
+  VkImage colorImage = VK_NULL_HANDLE;
+  VkImageView colorImageView = VK_NULL_HANDLE;
+  VkImage depthImage = VK_NULL_HANDLE;
+  VkImageView depthImageView = VK_NULL_HANDLE;
+};
+
+// A run of consecutive indirect commands recorded as one draw call.
+struct DrawJob {
+  uint32_t firstCommand = 0;
+  uint32_t commandCount = 0;
+};
+
+// CPU-side cost of the last drawFrame, split by where the time went.
+struct FrameTimings {
+  double simulateMs = 0.0;  // CPU magnet backend: step and pack; 0 otherwise
+  double fenceWaitMs = 0.0;
+  double acquireMs = 0.0;
+  double recordMs = 0.0;
+  double submitMs = 0.0;
+  double presentMs = 0.0;
+  uint64_t instanceUploadBytes = 0;  // instance data copied to the GPU for this frame
+  // The CPU spent longer waiting for the GPU (frame slot, swapchain image or offscreen target)
+  // than simulating and recording, so a deeper queue would not have made the frame faster.
+  bool gpuBound = false;
+
+  void classify() {
+    gpuBound = fenceWaitMs + acquireMs > simulateMs + recordMs;
+  }
+};
 
 class VulkanRenderer {
   public:
@@ -27,60 +159,142 @@ class VulkanRenderer {
     ~VulkanRenderer() {
     }
 
-    void init(std::shared_ptr<VulkanWindow> window, uint32_t width, uint32_t height) {
+    // A headless window (no GLFW window) selects the surface-less path: frames are rendered
+    // into a ring of offscreen targets and never presented.
+    void init(std::shared_ptr<VulkanWindow> window,
+              uint32_t width,
+              uint32_t height,
+              const RendererConfig &config = {}) {
       vulkanWindow = window;
+      headless = window->isHeadless();
+      gridWidth = config.gridWidth;
+      gridHeight = config.gridHeight;
+      lodScreenSizes = config.lodScreenSizes;
+      vertexFormat = config.vertexFormat;
+      optimizeMeshes = config.optimizeMeshes;
+      staticCommandBuffers = config.staticCommandBuffers;
+      presentProfile = config.presentProfile;
+      PresentProfileSettings presentSettings = presentProfileSettings(presentProfile);
+      framesInFlight = config.framesInFlight != 0 ? config.framesInFlight : presentSettings.framesInFlight;
+      createFrameSlots();
       vulkanInstance = std::make_unique<VulkanInstance>(window->getGLFWwindow());
 
       vulkanDevice = std::make_shared<VulkanDevice>(
         vulkanInstance->getVkInstance(),
-        vulkanInstance->getSurface()
-      );
-
-      vulkanSwapChain = std::make_shared<VulkanSwapChain>(
-        vulkanDevice,
         vulkanInstance->getSurface(),
-        width,
-        height
+        config.maxMsaaSamples,
+        config.dynamicRendering
       );
 
-      vulkanRenderPass = std::make_unique<VulkanRenderPass>(
-        vulkanDevice,
-        vulkanSwapChain->getImageFormat(),
-        vulkanDevice->getMsaaSamples(),
-        vulkanSwapChain->findDepthFormat()
-      );
+      VkFormat colorFormat;
+      if (headless) {
+        vulkanOffscreen = std::make_unique<VulkanOffscreenTargets>(
+          vulkanDevice,
+          width,
+          height,
+          OFFSCREEN_TARGET_COUNT
+        );
+        colorFormat = vulkanOffscreen->getImageFormat();
+      } else {
+        vulkanSwapChain = std::make_shared<VulkanSwapChain>(
+          vulkanDevice,
+          vulkanInstance->getSurface(),
+          width,
+          height,
+          presentSettings
+        );
+        colorFormat = vulkanSwapChain->getImageFormat();
+      }
 
-      vulkanSwapChain->createFramebuffers(vulkanRenderPass->getHandle());
+      dynamicRendering = vulkanDevice->supportsDynamicRendering();
+      if (!dynamicRendering) {
+        vulkanRenderPass = std::make_unique<VulkanRenderPass>(
+          vulkanDevice,
+          colorFormat,
+          vulkanDevice->getMsaaSamples(),
+          vulkanDevice->findDepthFormat(),
+          finalLayout()
+        );
+
+        if (headless) {
+          vulkanOffscreen->createFramebuffers(vulkanRenderPass->getHandle());
+        } else {
+          vulkanSwapChain->createFramebuffers(vulkanRenderPass->getHandle());
+        }
+      }
 
       vulkanDescriptors = std::make_unique<VulkanDescriptors>(vulkanDevice,
-                                                              vulkanSwapChain,
                                                               window,
-                                                              MAX_FRAMES_IN_FLIGHT);
+                                                              framesInFlight);
+
+      vulkanPipelineCache = std::make_unique<VulkanPipelineCache>(vulkanDevice, config.pipelineCachePath);
+      shaderLibrary = std::make_unique<ShaderLibrary>();
+      if (config.shaderHotReload) {
+        shaderLibrary->startWatching();
+      }
 
       vulkanPipeline = std::make_unique<VulkanPipeline>(
         vulkanDevice->getDevice(),
-        vulkanRenderPass->getHandle(),
+        vulkanPipelineCache->getHandle(),
+        pipelineTarget(),
         vulkanDescriptors->getDescriptorSetLayout(),
         vulkanDevice->getMsaaSamples(),
-        "../shaders/vert.spv",
-        "../shaders/frag.spv"
+        vertexShader(),
+        shaderLibrary->get(ShaderId::Fragment),
+        vertexFormat
       );
 
+      uint32_t recordingThreads = config.recordingThreads != 0
+                                    ? config.recordingThreads
+                                    : std::max(1u, std::thread::hardware_concurrency());
+      // A frame has at most one draw job per variant and LOD, and a worker without a job would
+      // only idle, so there are never more workers than that.
+      recordingThreads = std::min<uint32_t>(recordingThreads, HEX_VARIANT_COUNT * LOD_COUNT);
       vulkanCommands = std::make_unique<VulkanCommands>(
         vulkanDevice,
-        MAX_FRAMES_IN_FLIGHT
+        framesInFlight,
+        recordingThreads
+      );
+      if (recordingThreads > 1) {
+        recordingWorkers = std::make_unique<WorkerPool>(recordingThreads);
+      }
+
+      vulkanTimestamps = std::make_unique<VulkanTimestamps>(
+        vulkanDevice,
+        framesInFlight,
+        config.gpuTimingHistory
       );
 
+      vulkanUploader = std::make_unique<VulkanUploader>(vulkanDevice);
+
+      if (config.magnetBackend == MagnetBackend::Gpu) {
+        vulkanSimulation = std::make_unique<VulkanMagnetSimulation>(vulkanDevice,
+                                                                    framesInFlight,
+                                                                    config.magnets,
+                                                                    shaderLibrary->get(ShaderId::Magnets),
+                                                                    vertexFormat,
+                                                                    vulkanPipelineCache->getHandle());
+      } else if (config.magnetBackend == MagnetBackend::Cpu) {
+        cpuMagnets = std::make_unique<CpuMagnetSolver>(config.magnets, config.cpuSolverThreads);
+      }
+
+      multiDrawIndirect = vulkanDevice->supportsMultiDrawIndirect();
       generateHexagonData();
-      createVertexBuffer(edgeVertices, edgeVertexBuffer, edgeVertexBufferMemory);
-      createIndexBuffer(edgeIndices, edgeIndexBuffer, edgeIndexBufferMemory);
-      createVertexBuffer(internalVertices, internalVertexBuffer, internalVertexBufferMemory);
-      createIndexBuffer(internalIndices, internalIndexBuffer, internalIndexBufferMemory);
       prepareInstanceData();
+      vulkanUploader->flush();
+
+      if (config.gpuCulling) {
+        vulkanCulling = std::make_unique<VulkanCulling>(vulkanDevice,
+                                                        framesInFlight,
+                                                        shaderLibrary->get(ShaderId::Cull),
+                                                        vertexFormat,
+                                                        vulkanPipelineCache->getHandle());
+        vulkanCulling->setVariants(instanceBuffers.list(), getCullVariants());
+      }
 
       vulkanSync = std::make_unique<VulkanSync>(
         vulkanDevice,
-        MAX_FRAMES_IN_FLIGHT
+        framesInFlight
       );
 
       this->width = width;
@@ -88,39 +302,63 @@ class VulkanRenderer {
     }
 
     void cleanup() {
-      auto vkDev = vulkanDevice->getDevice();
-
-      vkDestroyBuffer(vkDev, edgeVertexBuffer, nullptr);
-      vkFreeMemory(vkDev, edgeVertexBufferMemory, nullptr);
-
-      vkDestroyBuffer(vkDev, edgeIndexBuffer, nullptr);
-      vkFreeMemory(vkDev, edgeIndexBufferMemory, nullptr);
-
-      vkDestroyBuffer(vkDev, internalVertexBuffer, nullptr);
-      vkFreeMemory(vkDev, internalVertexBufferMemory, nullptr);
-
-      vkDestroyBuffer(vkDev, internalIndexBuffer, nullptr);
-      vkFreeMemory(vkDev, internalIndexBufferMemory, nullptr);
-
-      vkDestroyBuffer(vkDev, edgeInstanceBuffer, nullptr);
-      vkFreeMemory(vkDev, edgeInstanceBufferMemory, nullptr);
+      if (shaderLibrary) {
+        shaderLibrary->stopWatching();
+      }
+      deletionQueue.flush();
+      vulkanUploader.reset();
+      vulkanCulling.reset();
+      vulkanSimulation.reset();
+      cpuMagnets.reset();
+      for (uint32_t i = 0; i < framesInFlight; i++) {
+        if (instanceStaging[i] != VK_NULL_HANDLE) {
+          vulkanDevice->destroyBuffer(instanceStaging[i], instanceStagingMemory[i]);
+        }
+      }
 
-      vkDestroyBuffer(vkDev, internalInstanceBuffer, nullptr);
-      vkFreeMemory(vkDev, internalInstanceBufferMemory, nullptr);
+      vulkanDevice->destroyBuffer(hexGeometry.vertexBuffer, hexGeometry.vertexMemory);
+      vulkanDevice->destroyBuffer(hexGeometry.indexBuffer, hexGeometry.indexMemory);
+      vulkanDevice->destroyBuffer(drawCommands, drawCommandsMemory);
+      for (uint32_t i = 0; i < framesInFlight; i++) {
+        vulkanDevice->destroyBuffer(instanceBuffers.buffers[i], instanceBuffers.memory[i]);
+      }
 
       vulkanSync.reset();
+      vulkanTimestamps.reset();
+      recordingWorkers.reset();
       vulkanCommands.reset();
       vulkanPipeline.reset();
+      shaderLibrary.reset();
+      if (vulkanPipelineCache) {
+        vulkanPipelineCache->save();
+        vulkanPipelineCache.reset();
+      }
       vulkanDescriptors.reset();
       vulkanRenderPass.reset();
       vulkanSwapChain.reset();
+      vulkanOffscreen.reset();
 
       vulkanDevice.reset();
       vulkanInstance.reset();
     }
 
     void drawFrame() {
-      vkWaitForFences(vulkanDevice->getDevice(), 1, vulkanSync->getInFlightFence(currentFrame), VK_TRUE, UINT64_MAX);
+      if (headless) {
+        drawFrameOffscreen();
+        return;
+      }
+
+      auto timer = Clock::now();
+      // The CPU solver steps while the GPU may still be busy; only packing needs the frame slot.
+      if (cpuMagnets) {
+        cpuMagnets->step();
+      }
+      frameTimings.simulateMs = lap(timer);
+      vulkanSync->waitForSlot(frameNumber);
+      frameTimings.fenceWaitMs = lap(timer);
+      vulkanTimestamps->collect(currentFrame);
+      deletionQueue.collect(vulkanSync->getCompletedFrameCount());
+      applyShaderReloads();
 
       uint32_t imageIndex;
       VkResult result =
@@ -130,6 +368,7 @@ class VulkanRenderer {
                               vulkanSync->getImageAvailableSemaphore(currentFrame),
                               VK_NULL_HANDLE,
                               &imageIndex);
+      frameTimings.acquireMs = lap(timer);
 
       if (result == VK_ERROR_OUT_OF_DATE_KHR) {
         recreateSwapChain();
@@ -137,34 +376,27 @@ class VulkanRenderer {
       } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
         throw std::runtime_error("failed to acquire swap chain image!");
       }
-      vulkanDescriptors->updateUniformBuffer(currentFrame);
-      vkResetFences(vulkanDevice->getDevice(), 1, vulkanSync->getInFlightFence(currentFrame));
-
-      vkResetCommandBuffer(vulkanCommands->getCommandBuffers()[currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
-      recordCommandBuffer(vulkanCommands->getCommandBuffers()[currentFrame], imageIndex, currentFrame);
-
-      VkSubmitInfo submitInfo{};
-      submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-      VkSemaphore waitSemaphores[] = {vulkanSync->getImageAvailableSemaphore(currentFrame)};
-      VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-      submitInfo.waitSemaphoreCount = 1;
-      submitInfo.pWaitSemaphores = waitSemaphores;
-      submitInfo.pWaitDstStageMask = waitStages;
+      // Staged only once the frame is certain to be submitted; taking the dirty ranges is final.
+      stageInstanceUpdates(currentFrame);
+      if (cpuMagnets) {
+        frameTimings.simulateMs += lap(timer);
+      }
+      updateCamera();
 
-      submitInfo.commandBufferCount = 1;
-      submitInfo.pCommandBuffers = &vulkanCommands->getCommandBuffers()[currentFrame];
+      VkCommandBuffer commandBuffer = prepareCommandBuffer(swapChainTarget(imageIndex),
+                                                           imageIndex,
+                                                           vulkanSwapChain->getImageCount());
+      frameTimings.recordMs = lap(timer);
 
       VkSemaphore signalSemaphores[] = {vulkanSync->getRenderFinishedSemaphore(currentFrame)};
-      submitInfo.signalSemaphoreCount = 1;
-      submitInfo.pSignalSemaphores = signalSemaphores;
-
-      if (vkQueueSubmit(vulkanDevice->getGraphicsQueue(),
-                        1,
-                        &submitInfo,
-                        *vulkanSync->getInFlightFence(currentFrame)) != VK_SUCCESS) {
-        throw std::runtime_error("failed to submit draw command buffer!");
-      }
+      vulkanSync->submitFrame(vulkanDevice->getGraphicsQueue(),
+                              commandBuffer,
+                              frameNumber,
+                              vulkanSync->getImageAvailableSemaphore(currentFrame),
+                              VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                              signalSemaphores[0]);
+      frameTimings.submitMs = lap(timer);
+      frameNumber++;
 
       VkPresentInfoKHR presentInfo{};
       presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -179,6 +411,8 @@ class VulkanRenderer {
       presentInfo.pImageIndices = &imageIndex;
 
       result = vkQueuePresentKHR(vulkanDevice->getPresentQueue(), &presentInfo);
+      frameTimings.presentMs = lap(timer);
+      frameTimings.classify();
 
       if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || vulkanWindow->framebufferResized) {
         vulkanWindow->framebufferResized = false;
@@ -187,7 +421,58 @@ class VulkanRenderer {
         throw std::runtime_error("failed to present swap chain image!");
       }
 
-      currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+      currentFrame = (currentFrame + 1) % framesInFlight;
+    }
+
+    // Same frame as drawFrame, minus acquire and present: the submit waits on nothing and the
+    // CPU only blocks on the frame slot or on a fully occupied offscreen ring.
+    void drawFrameOffscreen() {
+      auto timer = Clock::now();
+      // The CPU solver steps while the GPU may still be busy; only packing needs the frame slot.
+      if (cpuMagnets) {
+        cpuMagnets->step();
+      }
+      frameTimings.simulateMs = lap(timer);
+      vulkanSync->waitForSlot(frameNumber);
+      frameTimings.fenceWaitMs = lap(timer);
+      vulkanTimestamps->collect(currentFrame);
+      deletionQueue.collect(vulkanSync->getCompletedFrameCount());
+      applyShaderReloads();
+      stageInstanceUpdates(currentFrame);
+      if (cpuMagnets) {
+        frameTimings.simulateMs += lap(timer);
+      }
+
+      uint32_t targetIndex = vulkanOffscreen->acquireNextTarget(frameNumber, *vulkanSync);
+      frameTimings.acquireMs = lap(timer);
+
+      updateCamera();
+
+      VkCommandBuffer commandBuffer = prepareCommandBuffer(offscreenTarget(targetIndex),
+                                                           targetIndex,
+                                                           vulkanOffscreen->getTargetCount());
+      frameTimings.recordMs = lap(timer);
+
+      vulkanSync->submitFrame(vulkanDevice->getGraphicsQueue(), commandBuffer, frameNumber);
+      frameTimings.submitMs = lap(timer);
+      frameNumber++;
+      frameTimings.presentMs = 0.0;
+      frameTimings.classify();
+
+      lastOffscreenTarget = targetIndex;
+      currentFrame = (currentFrame + 1) % framesInFlight;
+    }
+
+    // Reads the most recently submitted offscreen frame back as RGBA8 rows. Blocks until that
+    // frame has finished on the GPU, so call it on request rather than every frame.
+    std::vector<uint8_t> readbackFrame() {
+      if (!headless) {
+        throw std::runtime_error("frame readback is only available in headless mode!");
+      }
+      return vulkanOffscreen->readback(lastOffscreenTarget,
+                                       vulkanCommands->getCommandPool(),
+                                       vulkanDevice->getGraphicsQueue(),
+                                       *vulkanSync);
     }
 
     void recreateSwapChain() {
@@ -197,18 +482,86 @@ class VulkanRenderer {
         glfwGetFramebufferSize(vulkanWindow->getGLFWwindow(), &width, &height);
         glfwWaitEvents();
       }
-      vkDeviceWaitIdle(vulkanDevice->getDevice());
-
-      vulkanSwapChain->recreate(width, height);
 
-      vulkanRenderPass->createRenderPass(vulkanSwapChain->getImageFormat(),
-                                         vulkanDevice->getMsaaSamples(),
-                                         vulkanSwapChain->findDepthFormat());
-      vulkanSwapChain->createFramebuffers(vulkanRenderPass->getHandle());
-      vulkanPipeline->createGraphicsPipeline(vulkanRenderPass->getHandle(),
+      // No device idle: frames still in flight keep rendering into the old generation, which is
+      // destroyed once the last frame submitted so far has retired.
+      auto retired = std::make_shared<RetiredSwapChain>(vulkanSwapChain->recreate(width, height));
+      deletionQueue.push(frameNumber, [swapChain = vulkanSwapChain, retired]() {
+        swapChain->destroyRetired(*retired);
+      });
+
+      // Viewport and scissor are dynamic, so the render pass and pipeline only depend on the
+      // attachment formats and sample count. A plain resize keeps both; only a surface format
+      // change (e.g. moving to an HDR display) rebuilds them, and that rare case still waits for
+      // the frames using the old ones. Dynamic rendering has no render pass or framebuffers to
+      // rebuild, and a pipeline built for other formats simply retires.
+      if (dynamicRendering) {
+        PipelineTarget target = pipelineTarget();
+        if (!vulkanPipeline->getTarget().sameFormats(target)) {
+          retirePipeline(vulkanPipeline->recreateGraphicsPipeline(target,
+                                                                  vulkanDevice->getMsaaSamples(),
+                                                                  vertexShader(),
+                                                                  shaderLibrary->get(ShaderId::Fragment)));
+          renderPassRebuilds++;
+        }
+      } else {
+        VkFormat depthFormat = vulkanSwapChain->findDepthFormat();
+        if (!vulkanRenderPass->matches(vulkanSwapChain->getImageFormat(), vulkanDevice->getMsaaSamples(), depthFormat)) {
+          vkDeviceWaitIdle(vulkanDevice->getDevice());
+          vulkanRenderPass->createRenderPass(vulkanSwapChain->getImageFormat(),
                                              vulkanDevice->getMsaaSamples(),
-                                             "../shaders/vert.spv",
-                                             "../shaders/frag.spv");
+                                             depthFormat);
+          retirePipeline(vulkanPipeline->recreateGraphicsPipeline(pipelineTarget(),
+                                                                  vulkanDevice->getMsaaSamples(),
+                                                                  vertexShader(),
+                                                                  shaderLibrary->get(ShaderId::Fragment)));
+          renderPassRebuilds++;
+        }
+        vulkanSwapChain->createFramebuffers(vulkanRenderPass->getHandle());
+      }
+      invalidateStaticCommands();
+      swapchainRecreations++;
+    }
+
+    // Rebuilds the pipelines whose shaders the watcher recompiled. Frames in flight keep the old
+    // pipelines, which retire through the deletion queue, so nothing waits for the device. A
+    // pipeline that fails to build leaves the previous one in place.
+    void applyShaderReloads() {
+      bool graphicsRebuilt = false;
+      for (ShaderId id : shaderLibrary->takeReloaded()) {
+        try {
+          switch (id) {
+            case ShaderId::Vertex:
+            case ShaderId::VertexCameraUniform:
+            case ShaderId::Fragment:
+              if (graphicsRebuilt) {
+                continue;
+              }
+              graphicsRebuilt = true;
+              retirePipeline(vulkanPipeline->recreateGraphicsPipeline(pipelineTarget(),
+                                                                      vulkanDevice->getMsaaSamples(),
+                                                                      vertexShader(),
+                                                                      shaderLibrary->get(ShaderId::Fragment)));
+              break;
+            case ShaderId::Cull:
+              if (vulkanCulling) {
+                retirePipeline(vulkanCulling->reloadPipeline(shaderLibrary->get(id)));
+              }
+              break;
+            case ShaderId::Magnets:
+              if (vulkanSimulation) {
+                retirePipeline(vulkanSimulation->reloadPipeline(shaderLibrary->get(id)));
+              }
+              break;
+            default:
+              break;
+          }
+          invalidateStaticCommands();
+          shaderReloads++;
+        } catch (const std::runtime_error &e) {
+          std::cerr << "shader reload: " << ShaderLibrary::sourceName(id) << ": " << e.what() << std::endl;
+        }
+      }
     }
 
     void setFramebufferResized(bool resized) { framebufferResized = resized; }
@@ -218,49 +571,324 @@ class VulkanRenderer {
     }
 
     VkDevice getDevice() const { return vulkanDevice->getDevice(); }
+    bool isHeadless() const { return headless; }
+    const FrameTimings &getFrameTimings() const { return frameTimings; }
+    const VulkanTimestamps &getGpuTimestamps() const { return *vulkanTimestamps; }
+
+    // Picks up the timestamps of frames still waiting in their slots. Only valid once the
+    // device is idle, e.g. after vkDeviceWaitIdle at the end of a run.
+    void flushGpuTimings() {
+      for (uint32_t i = 0; i < framesInFlight; i++) {
+        vulkanTimestamps->collect((currentFrame + i) % framesInFlight);
+      }
+    }
+    uint64_t getFrameNumber() const { return frameNumber; }
+    uint32_t getFramesInFlight() const { return framesInFlight; }
+    PresentProfile getPresentProfile() const { return presentProfile; }
+    // The mode the surface granted; headless frames are never presented.
+    const char *getPresentModeName() const {
+      return vulkanSwapChain ? presentModeName(vulkanSwapChain->getPresentMode()) : "none";
+    }
+    VkSampleCountFlagBits getMsaaSamples() const { return vulkanDevice->getMsaaSamples(); }
+    const GpuMemoryStats &getMemoryStats() const { return vulkanDevice->getMemoryStats(); }
+    size_t getInstanceCount() const { return instances.size(); }
+    // Whether each recorded draw call covers a whole run of indirect commands, and how many
+    // commands the lattice draws with per frame.
+    bool usesMultiDrawIndirect() const { return multiDrawIndirect; }
+    uint32_t getIndirectCommandCount() const {
+      return vulkanCulling ? vulkanCulling->getCommandCount() : HEX_VARIANT_COUNT;
+    }
+
+    // Sets one magnet's orientation from the CPU. Only the changed ranges are uploaded, into each
+    // frame slot's copy of the instance buffer as that slot comes round. A simulation backend
+    // owns the orientations and overwrites such edits on its next step.
+    void setMagnetAngle(int x, int y, float angle, float angularVelocity = 0.0f) {
+      if (x < 0 || y < 0 || x >= gridWidth || y >= gridHeight) {
+        throw std::out_of_range("magnet outside the grid!");
+      }
+      uint32_t slot = cellSlots[static_cast<size_t>(y) * gridWidth + x];
+      InstanceData instance = instances[slot];
+      instance.angle = angle;
+      instance.angularVelocity = angularVelocity;
+      instances.set(slot, instance);
+    }
+    // Integration steps run so far, and per frame; both 0 without the magnet simulation.
+    uint64_t getSimulationStepCount() const {
+      return vulkanSimulation ? vulkanSimulation->getStepCount() : cpuMagnets ? cpuMagnets->getStepCount() : 0;
+    }
+    uint32_t getSimulationStepsPerFrame() const {
+      return vulkanSimulation ? vulkanSimulation->getStepsPerFrame() : cpuMagnets ? cpuMagnets->getStepsPerFrame() : 0;
+    }
+    // CPU backend only: solver wall time so far, and its thread count.
+    uint64_t getCpuSolveNanoseconds() const { return cpuMagnets ? cpuMagnets->getSolveNanoseconds() : 0; }
+    uint32_t getCpuSolverThreads() const { return cpuMagnets ? cpuMagnets->getThreadCount() : 0; }
+    bool getCpuSolverSimd() const { return cpuMagnets && cpuMagnets->usesSimd(); }
+    uint32_t getRecordingThreads() const { return vulkanCommands->getWorkerCount(); }
+    size_t getPipelineCacheLoadedBytes() const { return vulkanPipelineCache->getLoadedBytes(); }
+    int getGridWidth() const { return gridWidth; }
+    int getGridHeight() const { return gridHeight; }
+    uint64_t getSwapchainRecreationCount() const { return swapchainRecreations; }
+    uint64_t getRenderPassRebuildCount() const { return renderPassRebuilds; }
+    uint64_t getShaderReloadCount() const { return shaderReloads; }
+    VertexFormat getVertexFormat() const { return vertexFormat; }
+    // [variant][lod]
+    const auto &getMeshReports() const { return hexGeometry.reports; }
+    bool usesStaticCommandBuffers() const { return staticCommandBuffers; }
+    bool usesDynamicRendering() const { return dynamicRendering; }
+    // Frames whose command buffer was recorded, and frames that resubmitted a static one.
+    uint64_t getRecordedFrameCount() const { return recordedFrames; }
+    uint64_t getReplayedFrameCount() const { return replayedFrames; }
+
+    // Rebuilds the lattice at a new size. Waits for the device, since frames in flight still
+    // read the instance buffers; they are reused when they are already large enough.
+    void setGridSize(int newWidth, int newHeight) {
+      if (newWidth <= 0 || newHeight <= 0) {
+        throw std::runtime_error("grid dimensions must be positive!");
+      }
+      if (newWidth == gridWidth && newHeight == gridHeight) {
+        return;
+      }
+      vkDeviceWaitIdle(vulkanDevice->getDevice());
+      gridWidth = newWidth;
+      gridHeight = newHeight;
+      prepareInstanceData();
+      vulkanUploader->flush();
+      if (vulkanCulling) {
+        vulkanCulling->setVariants(instanceBuffers.list(), getCullVariants());
+      }
+      invalidateStaticCommands();
+    }
+
+    VkExtent2D getRenderExtent() const {
+      return headless ? vulkanOffscreen->getExtent() : vulkanSwapChain->getExtent();
+    }
 
   private:
     std::unique_ptr<VulkanInstance> vulkanInstance;
     std::shared_ptr<VulkanDevice> vulkanDevice;
     std::shared_ptr<VulkanSwapChain> vulkanSwapChain;
+    std::unique_ptr<VulkanOffscreenTargets> vulkanOffscreen;
     std::unique_ptr<VulkanRenderPass> vulkanRenderPass;
     std::unique_ptr<VulkanPipeline> vulkanPipeline;
+    std::unique_ptr<VulkanPipelineCache> vulkanPipelineCache;
     std::unique_ptr<VulkanDescriptors> vulkanDescriptors;
     std::unique_ptr<VulkanCommands> vulkanCommands;
     std::unique_ptr<VulkanSync> vulkanSync;
+    std::unique_ptr<VulkanTimestamps> vulkanTimestamps;
+    std::unique_ptr<VulkanUploader> vulkanUploader;
+    std::unique_ptr<VulkanCulling> vulkanCulling;
+    std::unique_ptr<VulkanMagnetSimulation> vulkanSimulation;
+    std::unique_ptr<CpuMagnetSolver> cpuMagnets;
+    // Only when recording in parallel; worker 0 is the thread calling drawFrame.
+    std::unique_ptr<WorkerPool> recordingWorkers;
+    std::unique_ptr<ShaderLibrary> shaderLibrary;
     std::shared_ptr<VulkanWindow> vulkanWindow;
 
-    static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+    // From RendererConfig::framesInFlight; every per-frame resource has this many slots.
+    uint32_t framesInFlight = 2;
+    PresentProfile presentProfile = PresentProfile::Balanced;
+    static constexpr uint32_t OFFSCREEN_TARGET_COUNT = 3;
+    // Uniform block of each frame slot holding the camera for static command buffers.
+    static constexpr uint32_t CAMERA_BLOCK = 0;
+    static constexpr uint32_t LOD_COUNT = CULL_LOD_COUNT;
+    // Rebuilt for every recorded frame; at most one per recording worker.
+    std::vector<DrawJob> drawJobs;
+    // VulkanDevice::supportsMultiDrawIndirect: one draw call per job rather than per command.
+    bool multiDrawIndirect = false;
+    // This frame's camera: the separate matrices for culling, their product for the draws.
+    UniformBufferObject frameUniforms{};
+    CameraPushConstants cameraConstants{};
     uint32_t currentFrame = 0;
+    uint64_t frameNumber = 0;
+    bool headless = false;
+    uint32_t lastOffscreenTarget = 0;
+
+    using Clock = std::chrono::steady_clock;
+    FrameTimings frameTimings;
+
+    // Milliseconds since `since`, then restarts `since` at now.
+    static double lap(Clock::time_point &since) {
+      auto now = Clock::now();
+      double ms = std::chrono::duration<double, std::milli>(now - since).count();
+      since = now;
+      return ms;
+    }
     bool framebufferResized = false;
+    // Swapchain generations and other objects waiting for in-flight frames to retire.
+    VulkanDeletionQueue deletionQueue;
+    // Swapchain recreations, and how many of them also had to rebuild the render pass (with
+    // dynamic rendering: the pipeline, for new attachment formats).
+    uint64_t swapchainRecreations = 0;
+    uint64_t renderPassRebuilds = 0;
+    uint64_t shaderReloads = 0;
+
+    // The vertex shader variant matching how the camera reaches the draws, see bindDrawState.
+    const SpirvCode &vertexShader() const {
+      return shaderLibrary->get(staticCommandBuffers ? ShaderId::VertexCameraUniform : ShaderId::Vertex);
+    }
+
+    // Destroys a replaced pipeline once every frame submitted so far has finished with it.
+    void retirePipeline(VkPipeline pipeline) {
+      deletionQueue.push(frameNumber, [device = vulkanDevice->getDevice(), pipeline]() {
+        vkDestroyPipeline(device, pipeline, nullptr);
+      });
+    }
 
     uint32_t width = 800;
     uint32_t height = 600;
 
-    std::vector<Vertex> edgeVertices;
-    std::vector<uint16_t> edgeIndices;
-    std::vector<Vertex> internalVertices;
-    std::vector<uint16_t> internalIndices;
+    HexGeometry hexGeometry;
+    std::array<float, 2> lodScreenSizes = {48.0f, 12.0f};
+    VertexFormat vertexFormat = VertexFormat::Compact;
+    bool optimizeMeshes = true;
+
+    // RendererConfig::staticCommandBuffers. staticRecorded[slot * targets + target] says whether
+    // the matching VulkanCommands static buffer holds a valid recording.
+    bool staticCommandBuffers = false;
+    std::vector<bool> staticRecorded;
+    uint64_t recordedFrames = 0;
+    uint64_t replayedFrames = 0;
+
+    // RendererConfig::dynamicRendering where the device supports it; vulkanRenderPass and the
+    // framebuffers then do not exist.
+    bool dynamicRendering = false;
+
+    // Layout the finished image is left in: presentable, or ready for readback.
+    VkImageLayout finalLayout() const {
+      return headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    }
+
+    PipelineTarget pipelineTarget() const {
+      PipelineTarget target;
+      target.renderPass = vulkanRenderPass ? vulkanRenderPass->getHandle() : VK_NULL_HANDLE;
+      target.colorFormat = headless ? vulkanOffscreen->getImageFormat() : vulkanSwapChain->getImageFormat();
+      target.depthFormat = vulkanDevice->findDepthFormat();
+      return target;
+    }
+
+    RenderTarget swapChainTarget(uint32_t imageIndex) const {
+      RenderTarget target;
+      if (!dynamicRendering) {
+        target.framebuffer = vulkanSwapChain->getFramebuffers()[imageIndex];
+        return target;
+      }
+      target.image = vulkanSwapChain->getImage(imageIndex);
+      target.imageView = vulkanSwapChain->getImageViews()[imageIndex];
+      if (vulkanDevice->getMsaaSamples() != VK_SAMPLE_COUNT_1_BIT) {
+        target.colorImage = vulkanSwapChain->getColorImage();
+        target.colorImageView = vulkanSwapChain->getColorImageView();
+      }
+      target.depthImage = vulkanSwapChain->getDepthImage();
+      target.depthImageView = vulkanSwapChain->getDepthImageView();
+      return target;
+    }
 
-    VkBuffer edgeVertexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory edgeVertexBufferMemory = VK_NULL_HANDLE;
-    VkBuffer edgeIndexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory edgeIndexBufferMemory = VK_NULL_HANDLE;
+    RenderTarget offscreenTarget(uint32_t index) const {
+      RenderTarget target;
+      if (!dynamicRendering) {
+        target.framebuffer = vulkanOffscreen->getFramebuffer(index);
+        return target;
+      }
+      target.image = vulkanOffscreen->getImage(index);
+      target.imageView = vulkanOffscreen->getImageView(index);
+      if (vulkanDevice->getMsaaSamples() != VK_SAMPLE_COUNT_1_BIT) {
+        target.colorImage = vulkanOffscreen->getColorImage();
+        target.colorImageView = vulkanOffscreen->getColorImageView();
+      }
+      target.depthImage = vulkanOffscreen->getDepthImage();
+      target.depthImageView = vulkanOffscreen->getDepthImageView();
+      return target;
+    }
 
-    VkBuffer internalVertexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory internalVertexBufferMemory = VK_NULL_HANDLE;
-    VkBuffer internalIndexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory internalIndexBufferMemory = VK_NULL_HANDLE;
+    // Every hex, grouped by variant: variantRanges[v] is where variant v's instances are.
+    InstanceStore instances;
+    std::array<InstanceRange, HEX_VARIANT_COUNT> variantRanges{};
+    // Per grid cell, the index of its instance.
+    std::vector<uint32_t> cellSlots;
+    // Without culling, every variant drawn at LOD 0 with all its instances; only changes with
+    // the grid.
+    VkBuffer drawCommands = VK_NULL_HANDLE;
+    GpuAllocation drawCommandsMemory;
+
+    // Each frame slot draws from its own copy of the instance buffer, so updating a slot never
+    // waits on the frame still reading another.
+    struct FrameInstanceBuffers {
+      std::vector<VkBuffer> buffers;
+      std::vector<GpuAllocation> memory;
+      size_t capacity = 0;
+
+      void resize(uint32_t slots) {
+        buffers.assign(slots, VK_NULL_HANDLE);
+        memory.resize(slots);
+      }
+      [[nodiscard]] const std::vector<VkBuffer> &list() const { return buffers; }
+    };
+    FrameInstanceBuffers instanceBuffers;
+    float instanceBoundingRadius = 0.0f;
+
+    // Per frame slot, host-visible staging for the instance updates recorded into that frame.
+    std::vector<VkBuffer> instanceStaging;
+    std::vector<GpuAllocation> instanceStagingMemory;
+    std::vector<VkDeviceSize> instanceStagingCapacity;
+    std::vector<std::vector<VkBufferCopy>> instanceCopies;
+
+    // Sizes the renderer's own per-frame state; the Vulkan objects size theirs on creation.
+    void createFrameSlots() {
+      instances = InstanceStore(framesInFlight);
+      instanceBuffers.resize(framesInFlight);
+      instanceStaging.assign(framesInFlight, VK_NULL_HANDLE);
+      instanceStagingMemory.resize(framesInFlight);
+      instanceStagingCapacity.assign(framesInFlight, 0);
+      instanceCopies.resize(framesInFlight);
+    }
 
-    std::vector<InstanceData> edgeInstanceData;
-    std::vector<InstanceData> internalInstanceData;
+    // Submitted as this frame: the slot's static buffer for the target when it can be replayed,
+    // recording it first if needed, otherwise a fresh recording from the slot's frame pools.
+    VkCommandBuffer prepareCommandBuffer(const RenderTarget &renderTarget, uint32_t target, uint32_t targetCount) {
+      vulkanCommands->resetFrame(currentFrame);
+      if (!staticCommandBuffers || vulkanSimulation || cpuMagnets || !instanceCopies[currentFrame].empty()) {
+        VkCommandBuffer commandBuffer = vulkanCommands->getCommandBuffers()[currentFrame];
+        recordCommandBuffer(commandBuffer, renderTarget, currentFrame, false);
+        recordedFrames++;
+        return commandBuffer;
+      }
 
-    VkBuffer edgeInstanceBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory edgeInstanceBufferMemory = VK_NULL_HANDLE;
-    VkBuffer internalInstanceBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory internalInstanceBufferMemory = VK_NULL_HANDLE;
+      size_t index = static_cast<size_t>(currentFrame) * targetCount + target;
+      // Sized on first use; a new target count only comes with a swapchain recreation, which
+      // has already invalidated every recording.
+      if (staticRecorded.size() != static_cast<size_t>(framesInFlight) * targetCount) {
+        staticRecorded.assign(static_cast<size_t>(framesInFlight) * targetCount, false);
+      }
+      VkCommandBuffer commandBuffer = vulkanCommands->getStaticBuffer(index);
+      if (staticRecorded[index]) {
+        vulkanTimestamps->replayFrame(currentFrame, frameNumber);
+        replayedFrames++;
+      } else {
+        recordCommandBuffer(commandBuffer, renderTarget, currentFrame, true);
+        staticRecorded[index] = true;
+        recordedFrames++;
+      }
+      return commandBuffer;
+    }
 
-    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t currentFrame) {
+    // Drops every static recording; frames already submitted with them keep the old pool alive
+    // until they finish.
+    void invalidateStaticCommands() {
+      if (!staticCommandBuffers) {
+        return;
+      }
+      deletionQueue.push(frameNumber, [device = vulkanDevice->getDevice(), pool = vulkanCommands->retireStaticPool()]() {
+        vkDestroyCommandPool(device, pool, nullptr);
+      });
+      std::fill(staticRecorded.begin(), staticRecorded.end(), false);
+    }
+
+    // Reusable recordings are resubmitted after the slot's frame pools have been reset, so they
+    // draw inline instead of from pooled secondary buffers.
+    void recordCommandBuffer(VkCommandBuffer commandBuffer,
+                             const RenderTarget &target,
+                             uint32_t currentFrame,
+                             bool reusable) {
       VkCommandBufferBeginInfo beginInfo{};
       beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
@@ -268,89 +896,480 @@ class VulkanRenderer {
         throw std::runtime_error("failed to begin recording command buffer!");
       }
 
-      VkRenderPassBeginInfo renderPassInfo{};
-      renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-      renderPassInfo.renderPass = vulkanRenderPass->getHandle();
-      renderPassInfo.framebuffer = vulkanSwapChain->getFramebuffers()[imageIndex];
-      renderPassInfo.renderArea.offset = {0, 0};
-      renderPassInfo.renderArea.extent = vulkanSwapChain->getExtent();
+      vulkanTimestamps->beginFrame(commandBuffer, currentFrame, frameNumber);
+      vulkanTimestamps->writeTimestamp(commandBuffer,
+                                       currentFrame,
+                                       VulkanTimestamps::SIM_BEGIN,
+                                       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+      VkPipelineStageFlagBits simulationStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+      if (vulkanSimulation) {
+        vulkanSimulation->record(commandBuffer, currentFrame);
+        simulationStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+      } else if (recordInstanceCopies(commandBuffer, currentFrame)) {
+        simulationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+      }
+      vulkanTimestamps->writeTimestamp(commandBuffer, currentFrame, VulkanTimestamps::CULL_BEGIN, simulationStage);
+      if (vulkanCulling) {
+        vulkanCulling->record(commandBuffer, currentFrame);
+      }
+      // Stamped once the cull dispatches have left the compute stage.
+      vulkanTimestamps->writeTimestamp(commandBuffer,
+                                       currentFrame,
+                                       VulkanTimestamps::FRAME_BEGIN,
+                                       vulkanCulling ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                                                     : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+      buildDrawJobs();
+      // A single job gains nothing from a secondary buffer, so it is recorded inline.
+      if (recordingWorkers && !reusable && drawJobs.size() > 1) {
+        beginRendering(commandBuffer, target, true);
+        recordDrawJobsParallel(commandBuffer, target, currentFrame);
+      } else {
+        beginRendering(commandBuffer, target, false);
+        bindDrawState(commandBuffer, currentFrame);
+        vulkanTimestamps->writeTimestamp(commandBuffer, currentFrame, VulkanTimestamps::DRAW_BEGIN);
+        for (const DrawJob &job : drawJobs) {
+          recordDrawJob(commandBuffer, currentFrame, job);
+        }
+        vulkanTimestamps->writeTimestamp(commandBuffer, currentFrame, VulkanTimestamps::DRAW_END);
+      }
 
-      std::array<VkClearValue, 2> clearValues{};
-      clearValues[0].color = {{0.1f, 0.1f, 0.1f, 1.0f}};
-      clearValues[1].depthStencil = {1.0f, 0};
+      endRendering(commandBuffer, target);
 
-      renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-      renderPassInfo.pClearValues = clearValues.data();
+      vulkanTimestamps->writeTimestamp(commandBuffer, currentFrame, VulkanTimestamps::FRAME_END);
 
-      vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+      if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer!");
+      }
+    }
 
-      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanPipeline->getPipeline());
+    static VkImageMemoryBarrier imageBarrier(VkImage image,
+                                             VkImageAspectFlags aspect,
+                                             VkImageLayout oldLayout,
+                                             VkImageLayout newLayout,
+                                             VkAccessFlags srcAccess,
+                                             VkAccessFlags dstAccess) {
+      VkImageMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.srcAccessMask = srcAccess;
+      barrier.dstAccessMask = dstAccess;
+      barrier.oldLayout = oldLayout;
+      barrier.newLayout = newLayout;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = image;
+      barrier.subresourceRange.aspectMask = aspect;
+      barrier.subresourceRange.levelCount = 1;
+      barrier.subresourceRange.layerCount = 1;
+      return barrier;
+    }
 
-      vkCmdBindDescriptorSets(commandBuffer,
-                              VK_PIPELINE_BIND_POINT_GRAPHICS,
-                              vulkanPipeline->getLayout(),
-                              0,
-                              1,
-                              &vulkanDescriptors->getDescriptorSets()[currentFrame],
-                              0,
-                              nullptr);
+    // Starts drawing into the target with the frame's clear values. On the dynamic rendering
+    // path the barriers do what the render pass's initial layouts and external dependency do:
+    // every attachment starts UNDEFINED, since it is cleared anyway, and waits for the previous
+    // frame's attachment writes. The swapchain image is also only written once the acquire
+    // semaphore, waited on at COLOR_ATTACHMENT_OUTPUT, has signalled.
+    void beginRendering(VkCommandBuffer commandBuffer, const RenderTarget &target, bool secondaries) {
+      VkClearValue clearColor{};
+      clearColor.color = {{0.1f, 0.1f, 0.1f, 1.0f}};
+      VkClearValue clearDepth{};
+      clearDepth.depthStencil = {1.0f, 0};
+
+      if (!dynamicRendering) {
+        std::array<VkClearValue, 2> clearValues = {clearColor, clearDepth};
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = vulkanRenderPass->getHandle();
+        renderPassInfo.framebuffer = target.framebuffer;
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = getRenderExtent();
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+        vkCmdBeginRenderPass(commandBuffer,
+                             &renderPassInfo,
+                             secondaries ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                         : VK_SUBPASS_CONTENTS_INLINE);
+        return;
+      }
+
+      // Depth-stencil formats must transition both aspects, even though only depth is used.
+      VkFormat depthFormat = vulkanPipeline->getTarget().depthFormat;
+      VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+      if (depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || depthFormat == VK_FORMAT_D24_UNORM_S8_UINT) {
+        depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+      }
+      std::array<VkImageMemoryBarrier, 3> barriers{};
+      uint32_t barrierCount = 0;
+      barriers[barrierCount++] = imageBarrier(target.image,
+                                      VK_IMAGE_ASPECT_COLOR_BIT,
+                                      VK_IMAGE_LAYOUT_UNDEFINED,
+                                      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                      0,
+                                      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+      if (target.colorImage != VK_NULL_HANDLE) {
+        barriers[barrierCount++] = imageBarrier(target.colorImage,
+                                        VK_IMAGE_ASPECT_COLOR_BIT,
+                                        VK_IMAGE_LAYOUT_UNDEFINED,
+                                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+      }
+      barriers[barrierCount++] = imageBarrier(target.depthImage,
+                                      depthAspect,
+                                      VK_IMAGE_LAYOUT_UNDEFINED,
+                                      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                                      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+                                        | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+      vkCmdPipelineBarrier(commandBuffer,
+                           VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                           VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+                             | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                           0,
+                           0, nullptr,
+                           0, nullptr,
+                           barrierCount, barriers.data());
+
+      // With MSAA the multisampled image is rendered and averaged into the target at the end;
+      // like the render pass, only the resolved result is kept.
+      VkRenderingAttachmentInfoKHR colorAttachment{};
+      colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+      colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+      colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+      colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+      colorAttachment.clearValue = clearColor;
+      if (target.colorImage != VK_NULL_HANDLE) {
+        colorAttachment.imageView = target.colorImageView;
+        colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT_KHR;
+        colorAttachment.resolveImageView = target.imageView;
+        colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+      } else {
+        colorAttachment.imageView = target.imageView;
+      }
+
+      VkRenderingAttachmentInfoKHR depthAttachment{};
+      depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+      depthAttachment.imageView = target.depthImageView;
+      depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+      depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+      depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      depthAttachment.clearValue = clearDepth;
+
+      VkRenderingInfoKHR renderingInfo{};
+      renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+      renderingInfo.flags = secondaries ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0;
+      renderingInfo.renderArea.offset = {0, 0};
+      renderingInfo.renderArea.extent = getRenderExtent();
+      renderingInfo.layerCount = 1;
+      renderingInfo.colorAttachmentCount = 1;
+      renderingInfo.pColorAttachments = &colorAttachment;
+      renderingInfo.pDepthAttachment = &depthAttachment;
+      vulkanDevice->beginRendering(commandBuffer, renderingInfo);
+    }
+
+    // Ends drawing and, with dynamic rendering, moves the target to finalLayout() as the render
+    // pass's final layout would.
+    void endRendering(VkCommandBuffer commandBuffer, const RenderTarget &target) {
+      if (!dynamicRendering) {
+        vkCmdEndRenderPass(commandBuffer);
+        return;
+      }
+      vulkanDevice->endRendering(commandBuffer);
+
+      VkImageMemoryBarrier barrier = imageBarrier(target.image,
+                                                  VK_IMAGE_ASPECT_COLOR_BIT,
+                                                  VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                                  finalLayout(),
+                                                  VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                                  0);
+      vkCmdPipelineBarrier(commandBuffer,
+                           VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                           VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                           0,
+                           0, nullptr,
+                           0, nullptr,
+                           1, &barrier);
+    }
+
+    // Fills this slot's staging with what its instance buffer is missing: every magnet from the
+    // CPU solver, otherwise only the ranges edited since the slot was last recorded. The slot's
+    // fence has been waited on, so its staging and instance buffer are idle.
+    void stageInstanceUpdates(uint32_t currentFrame) {
+      auto &copies = instanceCopies[currentFrame];
+      copies.clear();
+      frameTimings.instanceUploadBytes = 0;
+      if (vulkanSimulation) {
+        return;
+      }
+
+      const VkDeviceSize stride = instanceStride(vertexFormat);
+      if (cpuMagnets) {
+        VkDeviceSize bytes = stride * instances.size();
+        if (bytes > 0) {
+          void *staged = reserveInstanceStaging(currentFrame, bytes);
+          if (vertexFormat == VertexFormat::Compact) {
+            cpuMagnets->pack(static_cast<CompactInstance *>(staged));
+          } else {
+            cpuMagnets->pack(static_cast<InstanceData *>(staged));
+          }
+          copies.push_back({0, 0, bytes});
+        }
+        frameTimings.instanceUploadBytes = bytes;
+        return;
+      }
+
+      std::vector<InstanceRange> ranges = instances.takeDirty(currentFrame);
+      VkDeviceSize bytes = 0;
+      for (const auto &range : ranges) {
+        bytes += stride * (range.end - range.begin);
+      }
+      if (bytes == 0) {
+        return;
+      }
+
+      auto *staging = static_cast<uint8_t *>(reserveInstanceStaging(currentFrame, bytes));
+      VkDeviceSize cursor = 0;
+      for (const auto &range : ranges) {
+        VkDeviceSize size = stride * (range.end - range.begin);
+        encodeInstances(vertexFormat, instances.data() + range.begin, range.end - range.begin, staging + cursor);
+        copies.push_back({cursor, stride * range.begin, size});
+        cursor += size;
+      }
+      frameTimings.instanceUploadBytes = bytes;
+    }
+
+    // Mapped staging of at least `bytes` for the slot, grown geometrically.
+    void *reserveInstanceStaging(uint32_t currentFrame, VkDeviceSize bytes) {
+      if (bytes > instanceStagingCapacity[currentFrame]) {
+        if (instanceStaging[currentFrame] != VK_NULL_HANDLE) {
+          vulkanDevice->destroyBuffer(instanceStaging[currentFrame], instanceStagingMemory[currentFrame]);
+        }
+        instanceStagingCapacity[currentFrame] = std::max(bytes, instanceStagingCapacity[currentFrame] * 3 / 2);
+        vulkanDevice->createBuffer(instanceStagingCapacity[currentFrame],
+                                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                   instanceStaging[currentFrame],
+                                   instanceStagingMemory[currentFrame]);
+      }
+      return instanceStagingMemory[currentFrame].mapped;
+    }
+
+    // Records the slot's staged copies and hands the instance buffer to the cull pass and the
+    // vertex input. Returns false when there was nothing to copy.
+    bool recordInstanceCopies(VkCommandBuffer commandBuffer, uint32_t currentFrame) {
+      const auto &copies = instanceCopies[currentFrame];
+      if (copies.empty()) {
+        return false;
+      }
+      vkCmdCopyBuffer(commandBuffer,
+                      instanceStaging[currentFrame],
+                      instanceBuffers.buffers[currentFrame],
+                      static_cast<uint32_t>(copies.size()),
+                      copies.data());
+
+      VkMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+      vkCmdPipelineBarrier(commandBuffer,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                           0,
+                           1, &barrier,
+                           0, nullptr,
+                           0, nullptr);
+      return true;
+    }
+
+    // Computes this frame's camera and writes what the GPU reads from memory: the cull
+    // parameters, and with static command buffers the draws' camera block. The slot is idle.
+    void updateCamera() {
+      frameUniforms = vulkanDescriptors->updateCamera(getRenderExtent());
+      cameraConstants.viewProj = frameUniforms.proj * frameUniforms.view * frameUniforms.model;
+      if (vulkanCulling) {
+        vulkanCulling->writeParams(currentFrame,
+                                   frameUniforms,
+                                   instanceBoundingRadius,
+                                   static_cast<float>(getRenderExtent().height),
+                                   lodScreenSizes);
+      }
+      if (staticCommandBuffers) {
+        vulkanDescriptors->writeUniformBlock(currentFrame, CAMERA_BLOCK, cameraConstants);
+      }
+    }
+
+    // Pipeline, camera, merged geometry and dynamic state every buffer recording draws must set
+    // first; secondary buffers inherit none of it. The camera is pushed, or with static command
+    // buffers bound as the slot's uniform block so replays pick up later frames' cameras.
+    void bindDrawState(VkCommandBuffer commandBuffer, uint32_t currentFrame) {
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanPipeline->getPipeline());
+      VkDeviceSize offset = 0;
+      vkCmdBindVertexBuffers(commandBuffer, 0, 1, &hexGeometry.vertexBuffer, &offset);
+      vkCmdBindIndexBuffer(commandBuffer, hexGeometry.indexBuffer, 0, hexGeometry.indexType);
+      if (staticCommandBuffers) {
+        VkDescriptorSet descriptorSet = vulkanDescriptors->getDescriptorSet();
+        uint32_t dynamicOffset = vulkanDescriptors->getDynamicOffset(currentFrame, CAMERA_BLOCK);
+        vkCmdBindDescriptorSets(commandBuffer,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                vulkanPipeline->getLayout(),
+                                0,
+                                1,
+                                &descriptorSet,
+                                1,
+                                &dynamicOffset);
+      } else {
+        vkCmdPushConstants(commandBuffer,
+                           vulkanPipeline->getLayout(),
+                           VK_SHADER_STAGE_VERTEX_BIT,
+                           0,
+                           sizeof(CameraPushConstants),
+                           &cameraConstants);
+      }
 
       VkViewport viewport{};
       viewport.x = 0.0f;
       viewport.y = 0.0f;
-      viewport.width = (float) vulkanSwapChain->getExtent().width;
-      viewport.height = (float) vulkanSwapChain->getExtent().height;
+      viewport.width = (float) getRenderExtent().width;
+      viewport.height = (float) getRenderExtent().height;
       viewport.minDepth = 0.0f;
       viewport.maxDepth = 1.0f;
       vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
       VkRect2D scissor{};
       scissor.offset = {0, 0};
-      scissor.extent = vulkanSwapChain->getExtent();
+      scissor.extent = getRenderExtent();
       vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    }
 
-      VkDeviceSize offsets[] = {0};
-
-      vkCmdBindVertexBuffers(commandBuffer, 0, 1, &edgeVertexBuffer, offsets);
-
-      vkCmdBindVertexBuffers(commandBuffer, 1, 1, &edgeInstanceBuffer, offsets);
-
-      vkCmdBindIndexBuffer(commandBuffer, edgeIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
-
-      vkCmdDrawIndexed(commandBuffer,
-                       static_cast<uint32_t>(edgeIndices.size()),
-                       static_cast<uint32_t>(edgeInstanceData.size()),
-                       0,
-                       0,
-                       0);
+    // The culled output has one command per variant and LOD, otherwise drawCommands has one per
+    // variant. With multi-draw indirect they all go in one draw call, which is cheaper to record
+    // inline than to split across secondaries; without it every command is its own job.
+    void buildDrawJobs() {
+      const uint32_t commandCount = getIndirectCommandCount();
+      drawJobs.clear();
+      if (multiDrawIndirect) {
+        drawJobs.push_back({0, commandCount});
+        return;
+      }
+      for (uint32_t c = 0; c < commandCount; c++) {
+        drawJobs.push_back({c, 1});
+      }
+    }
 
-      vkCmdBindVertexBuffers(commandBuffer, 0, 1, &internalVertexBuffer, offsets);
+    // Without multi-draw indirect the command's firstInstance is 0, so its range of instances is
+    // bound at an offset instead.
+    void recordDrawJob(VkCommandBuffer commandBuffer, uint32_t currentFrame, const DrawJob &job) {
+      VkBuffer instanceBuffer = vulkanCulling ? vulkanCulling->getVisibleInstances(currentFrame)
+                                              : instanceBuffers.buffers[currentFrame];
+      VkBuffer indirectBuffer = vulkanCulling ? vulkanCulling->getIndirectBuffer(currentFrame) : drawCommands;
+      VkDeviceSize instanceOffset = 0;
+      if (!multiDrawIndirect) {
+        instanceOffset = vulkanCulling ? vulkanCulling->getVisibleOffset(job.firstCommand)
+                                       : instanceStride(vertexFormat) * variantRanges[job.firstCommand].begin;
+      }
+      vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer, &instanceOffset);
+      vkCmdDrawIndexedIndirect(commandBuffer,
+                               indirectBuffer,
+                               VulkanCulling::COMMAND_STRIDE * job.firstCommand,
+                               job.commandCount,
+                               VulkanCulling::COMMAND_STRIDE);
+    }
 
-      vkCmdBindVertexBuffers(commandBuffer, 1, 1, &internalInstanceBuffer, offsets);
+    // Each worker records its share of the jobs into a secondary buffer from its own pool; the
+    // primary then executes them in worker order, so the draw order matches inline recording.
+    // Only as many workers as there are jobs take part, so every secondary has at least one
+    // draw, and the draw timestamps go into the first and last of them.
+    void recordDrawJobsParallel(VkCommandBuffer commandBuffer, const RenderTarget &target, uint32_t currentFrame) {
+      const size_t jobCount = drawJobs.size();
+      const auto workers = static_cast<uint32_t>(std::min<size_t>(vulkanCommands->getWorkerCount(), jobCount));
+      std::vector<VkCommandBuffer> secondaries(workers, VK_NULL_HANDLE);
+
+      // Secondaries continue either the render pass or, with no render pass, the dynamic
+      // rendering instance, whose attachment formats they have to repeat.
+      const PipelineTarget &pipelineFormats = vulkanPipeline->getTarget();
+      VkCommandBufferInheritanceRenderingInfoKHR inheritanceRendering{};
+      inheritanceRendering.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+      inheritanceRendering.colorAttachmentCount = 1;
+      inheritanceRendering.pColorAttachmentFormats = &pipelineFormats.colorFormat;
+      inheritanceRendering.depthAttachmentFormat = pipelineFormats.depthFormat;
+      inheritanceRendering.rasterizationSamples = vulkanDevice->getMsaaSamples();
+
+      VkCommandBufferInheritanceInfo inheritance{};
+      inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+      if (dynamicRendering) {
+        inheritance.pNext = &inheritanceRendering;
+      } else {
+        inheritance.renderPass = vulkanRenderPass->getHandle();
+        inheritance.subpass = 0;
+        inheritance.framebuffer = target.framebuffer;
+      }
 
-      vkCmdBindIndexBuffer(commandBuffer, internalIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
+      VkCommandBufferBeginInfo beginInfo{};
+      beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+      beginInfo.pInheritanceInfo = &inheritance;
 
-      vkCmdDrawIndexed(commandBuffer,
-                       static_cast<uint32_t>(internalIndices.size()),
-                       static_cast<uint32_t>(internalInstanceData.size()),
-                       0,
-                       0,
-                       0);
+      std::atomic<bool> failed{false};
+      recordingWorkers->run([&](uint32_t worker) {
+        if (worker >= workers) {
+          return;
+        }
+        try {
+          size_t begin = jobCount * worker / workers;
+          size_t end = jobCount * (worker + 1) / workers;
+          bool first = worker == 0;
+          bool last = worker == workers - 1;
+
+          VkCommandBuffer secondary = vulkanCommands->acquireSecondary(currentFrame, worker);
+          if (vkBeginCommandBuffer(secondary, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording secondary command buffer!");
+          }
+          bindDrawState(secondary, currentFrame);
+          if (first) {
+            vulkanTimestamps->writeTimestamp(secondary, currentFrame, VulkanTimestamps::DRAW_BEGIN);
+          }
+          for (size_t j = begin; j < end; j++) {
+            recordDrawJob(secondary, currentFrame, drawJobs[j]);
+          }
+          if (last) {
+            vulkanTimestamps->writeTimestamp(secondary, currentFrame, VulkanTimestamps::DRAW_END);
+          }
+          if (vkEndCommandBuffer(secondary) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record secondary command buffer!");
+          }
+          secondaries[worker] = secondary;
+        } catch (...) {
+          failed = true;
+        }
+      });
+      if (failed) {
+        throw std::runtime_error("failed to record draw jobs!");
+      }
 
-      vkCmdEndRenderPass(commandBuffer);
+      vkCmdExecuteCommands(commandBuffer, workers, secondaries.data());
+    }
 
-      if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to record command buffer!");
+    std::vector<CullVariant> getCullVariants() const {
+      std::vector<CullVariant> variants(HEX_VARIANT_COUNT);
+      for (uint32_t v = 0; v < HEX_VARIANT_COUNT; v++) {
+        variants[v].firstInstance = static_cast<uint32_t>(variantRanges[v].begin);
+        variants[v].instanceCount = static_cast<uint32_t>(variantRanges[v].end - variantRanges[v].begin);
+        variants[v].lods = hexGeometry.meshes[v];
       }
+      return variants;
+    }
+
+    [[nodiscard]] HexVariant variantOf(int x, int y) const {
+      return isEdgeHexagon(x, y) ? EDGE_HEX : INTERNAL_HEX;
     }
 
     [[nodiscard]] bool isEdgeHexagon(int x, int y) const {
-      return (x == 0 || x == GRID_WIDTH - 1 || y == 0 || y == GRID_HEIGHT - 1);
+      return (x == 0 || x == gridWidth - 1 || y == 0 || y == gridHeight - 1);
     }
 
     [[nodiscard]] glm::vec2 calculatePositionOffset(const int gridX, const int gridY) const {
-      float xOffset = (static_cast<float>(gridX) - static_cast<float>(GRID_WIDTH - 1) / 2.0f) * 1.5f;
-      float yOffset = (static_cast<float>(gridY) - static_cast<float>(GRID_HEIGHT - 1) / 2.0f) * sqrt(3.0f);
+      float xOffset = (static_cast<float>(gridX) - static_cast<float>(gridWidth - 1) / 2.0f) * 1.5f;
+      float yOffset = (static_cast<float>(gridY) - static_cast<float>(gridHeight - 1) / 2.0f) * sqrt(3.0f);
 
       if (gridY % 2 == 1) {
         xOffset += 0.75f;
@@ -362,29 +1381,145 @@ class VulkanRenderer {
       return {xOffset, yOffset};
     }
 
-    void createInstanceBuffer(const std::vector<InstanceData> &instanceData,
-                              VkBuffer &buffer,
-                              VkDeviceMemory &bufferMemory) {
-      VkDeviceSize bufferSize = sizeof(InstanceData) * instanceData.size();
-      vulkanDevice->createBuffer(bufferSize,
-                                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                 buffer,
-                                 bufferMemory);
-
-      void *data;
-      vkMapMemory(vulkanDevice->getDevice(), bufferMemory, 0, bufferSize, 0, &data);
-      memcpy(data, instanceData.data(), (size_t) bufferSize);
-      vkUnmapMemory(vulkanDevice->getDevice(), bufferMemory);
+    // Grows geometrically, so rebuilding a lattice of similar size reuses the buffers and only
+    // re-uploads the instance data. Every frame slot's copy is written in full, which leaves the
+    // store with nothing dirty.
+    void updateInstanceBuffer(std::vector<InstanceData> instanceData) {
+      if (instanceBuffers.buffers[0] == VK_NULL_HANDLE || instanceData.size() > instanceBuffers.capacity) {
+        instanceBuffers.capacity = std::max<size_t>({instanceData.size(),
+                                                     instanceBuffers.capacity + instanceBuffers.capacity / 2,
+                                                     1});
+        for (uint32_t i = 0; i < framesInFlight; i++) {
+          if (instanceBuffers.buffers[i] != VK_NULL_HANDLE) {
+            vulkanDevice->destroyBuffer(instanceBuffers.buffers[i], instanceBuffers.memory[i]);
+          }
+          vulkanDevice->createBuffer(instanceStride(vertexFormat) * instanceBuffers.capacity,
+                                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+                                     | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                                     | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                     instanceBuffers.buffers[i],
+                                     instanceBuffers.memory[i]);
+        }
+      }
+      if (!instanceData.empty()) {
+        std::vector<uint8_t> encoded(instanceStride(vertexFormat) * instanceData.size());
+        encodeInstances(vertexFormat, instanceData.data(), instanceData.size(), encoded.data());
+        for (uint32_t i = 0; i < framesInFlight; i++) {
+          vulkanUploader->upload(instanceBuffers.buffers[i], 0, encoded.data(), encoded.size());
+        }
+      }
+      instances.assign(std::move(instanceData));
     }
 
+    // Builds every LOD of every hex variant into one vertex and one index buffer, recording
+    // where each mesh landed, and sizes the culling sphere to the largest of them, matching the
+    // 0.1 scale in shader.vert. Meshes keep their own vertex numbering, applied through
+    // vertexOffset, so the indices stay narrow however many meshes there are. Each mesh goes
+    // through the optimizer first, since every vertex it saves is saved once per instance.
     void generateHexagonData() {
-      generateHexagonMesh(true, edgeVertices, edgeIndices);
+      std::vector<Vertex> vertices;
+      std::vector<uint32_t> indices;
+      float maxLength = 0.0f;
+      for (uint32_t variant = 0; variant < HEX_VARIANT_COUNT; variant++) {
+        for (uint32_t lod = 0; lod < LOD_COUNT; lod++) {
+          std::vector<Vertex> meshVertices;
+          std::vector<uint32_t> meshIndices;
+          generateHexagonLod(lod, variant == EDGE_HEX, meshVertices, meshIndices);
+          MeshOptimizationReport &report = hexGeometry.reports[variant][lod];
+          if (optimizeMeshes) {
+            report = optimizeMesh(meshVertices, meshIndices);
+          } else {
+            report.before = report.after = analyzeMesh(meshIndices, static_cast<uint32_t>(meshVertices.size()));
+          }
+          for (const auto &vertex : meshVertices) {
+            maxLength = std::max(maxLength, glm::length(vertex.pos));
+          }
 
-      generateHexagonMesh(false, internalVertices, internalIndices);
+          MeshRange &mesh = hexGeometry.meshes[variant][lod];
+          mesh.firstIndex = static_cast<uint32_t>(indices.size());
+          mesh.indexCount = static_cast<uint32_t>(meshIndices.size());
+          mesh.vertexOffset = static_cast<int32_t>(vertices.size());
+          vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+          indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
+        }
+      }
+      createVertexBuffer(vertices, hexGeometry.vertexBuffer, hexGeometry.vertexMemory);
+      createIndexBuffer(indices, hexGeometry.indexBuffer, hexGeometry.indexMemory, hexGeometry.indexType);
+      instanceBoundingRadius = maxLength * 0.1f;
+
+      vulkanDevice->createBuffer(VulkanCulling::COMMAND_STRIDE * HEX_VARIANT_COUNT,
+                                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                 drawCommands,
+                                 drawCommandsMemory);
     }
 
-    void generateHexagonMesh(bool includeSides, std::vector<Vertex> &vertices, std::vector<uint16_t> &indices) {
+    // LOD 0 is the full bevelled hex. The coarser levels are written by hand rather than
+    // simplified from it, so each keeps the colours that still read at its size: LOD 1 drops the
+    // side panels, keeps the black rim on top and flattens both caps to 4-triangle hexagons.
+    // LOD 2 is a flat 4-triangle hexagon per cap, 8 triangles in all rather than 4: magnets
+    // flip about their x axis and back faces are culled, so a single cap would vanish whenever
+    // a far hex shows its white underside.
+    void generateHexagonLod(uint32_t lod,
+                            bool includeSides,
+                            std::vector<Vertex> &vertices,
+                            std::vector<uint32_t> &indices) {
+      constexpr float radius_inner = 0.9f;
+      constexpr float rim_width = 0.111f;
+      constexpr float rotationAngle = glm::radians(30.0f);
+      constexpr float height = 1.0f;
+      constexpr auto blackColor = glm::vec3(0.0f, 0.0f, 0.0f);
+      constexpr auto greenColor = glm::vec3(0.293f, 0.711f, 0.129f);
+      constexpr auto whiteColor = glm::vec3(1.0f, 1.0f, 1.0f);
+
+      if (lod == 0) {
+        generateHexagonMesh(includeSides, vertices, indices);
+        return;
+      }
+
+      if (lod == 1) {
+        generateHexagonCap(radius_inner, rotationAngle, height, greenColor, true, vertices, indices);
+
+        const auto baseIndexInnerBlack = static_cast<uint32_t>(vertices.size());
+        offsetNVertSurface(vertices.end(), vertices, 0.0f, blackColor, 6);
+
+        const auto baseIndexOuter = static_cast<uint32_t>(vertices.size());
+        offsetNVertSurface(vertices.end(), vertices, rim_width, blackColor, 6);
+
+        for (uint32_t i = 0; i < 6; ++i) {
+          indices.push_back(baseIndexInnerBlack + i);
+          indices.push_back(baseIndexOuter + i);
+          indices.push_back(baseIndexOuter + ((i + 1) % 6));
+
+          indices.push_back(baseIndexInnerBlack + i);
+          indices.push_back(baseIndexOuter + ((i + 1) % 6));
+          indices.push_back(baseIndexInnerBlack + ((i + 1) % 6));
+        }
+      } else {
+        generateHexagonCap(radius_inner + rim_width, rotationAngle, height, greenColor, true, vertices, indices);
+      }
+      generateHexagonCap(radius_inner + rim_width, rotationAngle, -height, whiteColor, false, vertices, indices);
+    }
+
+    // Flat hexagon as a 4-triangle fan from its first corner, wound to face up or down.
+    void generateHexagonCap(float radius,
+                            float rotationAngle,
+                            float height,
+                            glm::vec3 color,
+                            bool facingUp,
+                            std::vector<Vertex> &vertices,
+                            std::vector<uint32_t> &indices) {
+      const auto base = static_cast<uint32_t>(vertices.size());
+      generateNSidedShapeVertices(6, radius, rotationAngle, height, color, vertices);
+      for (uint32_t i = 1; i < 5; ++i) {
+        indices.push_back(base);
+        indices.push_back(base + (facingUp ? i : i + 1));
+        indices.push_back(base + (facingUp ? i + 1 : i));
+      }
+    }
+
+    void generateHexagonMesh(bool includeSides, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
       constexpr float radius_outer = 1.0f;
       constexpr float radius_inner = 0.9f;
       constexpr float rotationAngle = glm::radians(30.0f);
@@ -394,23 +1529,23 @@ class VulkanRenderer {
       constexpr auto brownColor = glm::vec3(0.367f, 0.172f, 0.039f);
       constexpr auto whiteColor = glm::vec3(1.0f, 1.0f, 1.0f);
 
-      const auto baseIndexInnerGreen = static_cast<uint16_t>(vertices.size());
+      const auto baseIndexInnerGreen = static_cast<uint32_t>(vertices.size());
       generateNSidedShapeWithCenterVertices(6, radius_inner, rotationAngle, height, greenColor, vertices);
-      auto centerIndex = static_cast<uint16_t>(vertices.size() - 1);
+      auto centerIndex = static_cast<uint32_t>(vertices.size() - 1);
 
-      for (uint16_t i = 0; i < 6; ++i) {
+      for (uint32_t i = 0; i < 6; ++i) {
         indices.push_back(baseIndexInnerGreen + i);
         indices.push_back(baseIndexInnerGreen + ((i + 1) % 6));
         indices.push_back(centerIndex);
       }
 
-      const auto baseIndexInnerBlack = static_cast<uint16_t>(vertices.size());
+      const auto baseIndexInnerBlack = static_cast<uint32_t>(vertices.size());
       offsetNVertSurface(vertices.end() - 1, vertices, 0.0f, blackColor, 6);
 
-      const auto baseIndexOuter = static_cast<uint16_t>(vertices.size());
+      const auto baseIndexOuter = static_cast<uint32_t>(vertices.size());
       offsetNVertSurface(vertices.end(), vertices, 0.111f, blackColor, 6);
 
-      for (uint16_t i = 0; i < 6; ++i) {
+      for (uint32_t i = 0; i < 6; ++i) {
         indices.push_back(baseIndexInnerBlack + i);
         indices.push_back(baseIndexOuter + i);
         indices.push_back(baseIndexOuter + ((i + 1) % 6));
@@ -420,23 +1555,23 @@ class VulkanRenderer {
         indices.push_back(baseIndexInnerBlack + ((i + 1) % 6));
       }
 
-      const auto baseIndexInnerGreenBot = static_cast<uint16_t>(vertices.size());
+      const auto baseIndexInnerGreenBot = static_cast<uint32_t>(vertices.size());
       generateNSidedShapeWithCenterVertices(6, radius_inner, rotationAngle, -height, whiteColor, vertices);
-      auto centerIndexBot = static_cast<uint16_t>(vertices.size() - 1);
+      auto centerIndexBot = static_cast<uint32_t>(vertices.size() - 1);
 
-      for (uint16_t i = 0; i < 6; ++i) {
+      for (uint32_t i = 0; i < 6; ++i) {
         indices.push_back(baseIndexInnerGreenBot + i);
         indices.push_back(centerIndexBot);
         indices.push_back(baseIndexInnerGreenBot + ((i + 1) % 6));
       }
 
-      const auto baseIndexInnerBlackBot = static_cast<uint16_t>(vertices.size());
+      const auto baseIndexInnerBlackBot = static_cast<uint32_t>(vertices.size());
       offsetNVertSurface(vertices.end() - 1, vertices, 0.0f, blackColor, 6);
 
-      const auto baseIndexOuterBot = static_cast<uint16_t>(vertices.size());
+      const auto baseIndexOuterBot = static_cast<uint32_t>(vertices.size());
       offsetNVertSurface(vertices.end(), vertices, 0.11f, blackColor, 6);
 
-      for (uint16_t i = 0; i < 6; ++i) {
+      for (uint32_t i = 0; i < 6; ++i) {
         indices.push_back(baseIndexOuterBot + i);
         indices.push_back(baseIndexInnerBlackBot + i);
         indices.push_back(baseIndexOuterBot + ((i + 1) % 6));
@@ -447,11 +1582,11 @@ class VulkanRenderer {
       }
 
       if (includeSides) {
-        for (uint16_t i = 0; i < 6; ++i) {
-          uint16_t topOuterCurr = baseIndexOuter + i;
-          uint16_t topOuterNext = baseIndexOuter + ((i + 1) % 6);
-          uint16_t bottomOuterCurr = baseIndexOuterBot + i;
-          uint16_t bottomOuterNext = baseIndexOuterBot + ((i + 1) % 6);
+        for (uint32_t i = 0; i < 6; ++i) {
+          uint32_t topOuterCurr = baseIndexOuter + i;
+          uint32_t topOuterNext = baseIndexOuter + ((i + 1) % 6);
+          uint32_t bottomOuterCurr = baseIndexOuterBot + i;
+          uint32_t bottomOuterNext = baseIndexOuterBot + ((i + 1) % 6);
 
           Vertex v0 = vertices[topOuterCurr];
           v0.color = blackColor;
@@ -464,13 +1599,13 @@ class VulkanRenderer {
 
           std::vector<Vertex> originalSquare{v0, v1, v2, v3};
 
-          uint16_t idx_v0 = static_cast<uint16_t>(vertices.size());
+          uint32_t idx_v0 = static_cast<uint32_t>(vertices.size());
           vertices.push_back(v0);
-          uint16_t idx_v1 = static_cast<uint16_t>(vertices.size());
+          uint32_t idx_v1 = static_cast<uint32_t>(vertices.size());
           vertices.push_back(v1);
-          uint16_t idx_v2 = static_cast<uint16_t>(vertices.size());
+          uint32_t idx_v2 = static_cast<uint32_t>(vertices.size());
           vertices.push_back(v2);
-          uint16_t idx_v3 = static_cast<uint16_t>(vertices.size());
+          uint32_t idx_v3 = static_cast<uint32_t>(vertices.size());
           vertices.push_back(v3);
 
           std::vector<Vertex> offsetVerticesBlack;
@@ -479,13 +1614,13 @@ class VulkanRenderer {
 
           offsetNVertSurfaceWithCenter(originalSquare, offsetVerticesBlack, offsetInwards, blackColor, centerVertex);
 
-          uint16_t idx_offset_v0 = static_cast<uint16_t>(vertices.size());
+          uint32_t idx_offset_v0 = static_cast<uint32_t>(vertices.size());
           vertices.push_back(offsetVerticesBlack[0]);
-          uint16_t idx_offset_v1 = static_cast<uint16_t>(vertices.size());
+          uint32_t idx_offset_v1 = static_cast<uint32_t>(vertices.size());
           vertices.push_back(offsetVerticesBlack[1]);
-          uint16_t idx_offset_v2 = static_cast<uint16_t>(vertices.size());
+          uint32_t idx_offset_v2 = static_cast<uint32_t>(vertices.size());
           vertices.push_back(offsetVerticesBlack[2]);
-          uint16_t idx_offset_v3 = static_cast<uint16_t>(vertices.size());
+          uint32_t idx_offset_v3 = static_cast<uint32_t>(vertices.size());
           vertices.push_back(offsetVerticesBlack[3]);
 
           std::vector<Vertex> offsetVerticesBrown = offsetVerticesBlack;
@@ -493,17 +1628,17 @@ class VulkanRenderer {
             v.color = brownColor;
           }
 
-          uint16_t idx_brown_v0 = static_cast<uint16_t>(vertices.size());
+          uint32_t idx_brown_v0 = static_cast<uint32_t>(vertices.size());
           vertices.push_back(offsetVerticesBrown[0]);
-          uint16_t idx_brown_v1 = static_cast<uint16_t>(vertices.size());
+          uint32_t idx_brown_v1 = static_cast<uint32_t>(vertices.size());
           vertices.push_back(offsetVerticesBrown[1]);
-          uint16_t idx_brown_v2 = static_cast<uint16_t>(vertices.size());
+          uint32_t idx_brown_v2 = static_cast<uint32_t>(vertices.size());
           vertices.push_back(offsetVerticesBrown[2]);
-          uint16_t idx_brown_v3 = static_cast<uint16_t>(vertices.size());
+          uint32_t idx_brown_v3 = static_cast<uint32_t>(vertices.size());
           vertices.push_back(offsetVerticesBrown[3]);
 
           centerVertex.color = brownColor;
-          uint16_t idx_center = static_cast<uint16_t>(vertices.size());
+          uint32_t idx_center = static_cast<uint32_t>(vertices.size());
           vertices.push_back(centerVertex);
 
           indices.push_back(idx_v0);
@@ -661,96 +1796,130 @@ class VulkanRenderer {
       }
     }
 
+    // Uploads in the configured vertex format.
     void createVertexBuffer(const std::vector<Vertex> &vertices,
                             VkBuffer &vertexBuffer,
-                            VkDeviceMemory &vertexBufferMemory) {
-      VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-
-      VkBufferCreateInfo bufferInfo{};
-      bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-      bufferInfo.size = bufferSize;
-      bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-      bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-      if (vkCreateBuffer(vulkanDevice->getDevice(), &bufferInfo, nullptr, &vertexBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create vertex buffer!");
-      }
-
-      VkMemoryRequirements memRequirements;
-      vkGetBufferMemoryRequirements(vulkanDevice->getDevice(), vertexBuffer, &memRequirements);
-
-      VkMemoryAllocateInfo allocInfo{};
-      allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      allocInfo.allocationSize = memRequirements.size;
-      allocInfo.memoryTypeIndex =
-        vulkanDevice->findMemoryType(memRequirements.memoryTypeBits,
-                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-      if (vkAllocateMemory(vulkanDevice->getDevice(), &allocInfo, nullptr, &vertexBufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
+                            GpuAllocation &vertexBufferMemory) {
+      std::vector<CompactVertex> compact;
+      const void *data = vertices.data();
+      if (vertexFormat == VertexFormat::Compact) {
+        compact.reserve(vertices.size());
+        for (const Vertex &vertex : vertices) {
+          compact.emplace_back(vertex);
+        }
+        data = compact.data();
       }
-
-      vkBindBufferMemory(vulkanDevice->getDevice(), vertexBuffer, vertexBufferMemory, 0);
-
-      void *data;
-      vkMapMemory(vulkanDevice->getDevice(), vertexBufferMemory, 0, bufferSize, 0, &data);
-      memcpy(data, vertices.data(), (size_t) bufferSize);
-      vkUnmapMemory(vulkanDevice->getDevice(), vertexBufferMemory);
+      VkDeviceSize bufferSize = Vertex::stride(vertexFormat) * vertices.size();
+      vulkanUploader->createDeviceLocalBuffer(data,
+                                              bufferSize,
+                                              VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                              vertexBuffer,
+                                              vertexBufferMemory);
     }
 
-    void createIndexBuffer(const std::vector<uint16_t> &indices,
+    // Packs to 16-bit indices whenever the mesh allows it and reports the type to bind with.
+    void createIndexBuffer(const std::vector<uint32_t> &indices,
                            VkBuffer &indexBuffer,
-                           VkDeviceMemory &indexBufferMemory) {
-      VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-
-      VkBufferCreateInfo bufferInfo{};
-      bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-      bufferInfo.size = bufferSize;
-      bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-      bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                           GpuAllocation &indexBufferMemory,
+                           VkIndexType &indexType) {
+      PackedIndices packed = PackedIndices::pack(indices);
+      indexType = packed.type;
+      vulkanUploader->createDeviceLocalBuffer(packed.bytes.data(),
+                                              packed.bytes.size(),
+                                              VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                              indexBuffer,
+                                              indexBufferMemory);
+    }
 
-      if (vkCreateBuffer(vulkanDevice->getDevice(), &bufferInfo, nullptr, &indexBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create index buffer!");
+    // Lays the lattice out variant by variant, so each variant's instances are one contiguous
+    // range that a single indirect command can draw.
+    void prepareInstanceData() {
+      const size_t total = static_cast<size_t>(gridWidth) * static_cast<size_t>(gridHeight);
+      if (total > UINT32_MAX) {
+        throw std::runtime_error("grid has more instances than a draw can address!");
       }
 
-      VkMemoryRequirements memRequirements;
-      vkGetBufferMemoryRequirements(vulkanDevice->getDevice(), indexBuffer, &memRequirements);
+      std::array<size_t, HEX_VARIANT_COUNT> next{};
+      for (int y = 0; y < gridHeight; ++y) {
+        for (int x = 0; x < gridWidth; ++x) {
+          next[variantOf(x, y)]++;
+        }
+      }
+      size_t first = 0;
+      for (uint32_t v = 0; v < HEX_VARIANT_COUNT; v++) {
+        variantRanges[v] = {first, first + next[v]};
+        next[v] = first;
+        first = variantRanges[v].end;
+      }
 
-      VkMemoryAllocateInfo allocInfo{};
-      allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      allocInfo.allocationSize = memRequirements.size;
-      allocInfo.memoryTypeIndex =
-        vulkanDevice->findMemoryType(memRequirements.memoryTypeBits,
-                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+      std::vector<InstanceData> instanceData(total);
+      cellSlots.clear();
+      cellSlots.reserve(total);
 
-      if (vkAllocateMemory(vulkanDevice->getDevice(), &allocInfo, nullptr, &indexBufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate index buffer memory!");
+      const bool simulated = vulkanSimulation || cpuMagnets;
+      std::vector<InstanceData> magnets;
+      if (simulated) {
+        magnets.reserve(total);
       }
 
-      vkBindBufferMemory(vulkanDevice->getDevice(), indexBuffer, indexBufferMemory, 0);
-
-      void *data;
-      vkMapMemory(vulkanDevice->getDevice(), indexBufferMemory, 0, bufferSize, 0, &data);
-      memcpy(data, indices.data(), (size_t) bufferSize);
-      vkUnmapMemory(vulkanDevice->getDevice(), indexBufferMemory);
-    }
-    void prepareInstanceData() {
-      for (int y = 0; y < GRID_HEIGHT; ++y) {
-        for (int x = 0; x < GRID_WIDTH; ++x) {
+      for (int y = 0; y < gridHeight; ++y) {
+        for (int x = 0; x < gridWidth; ++x) {
           InstanceData inst{};
           inst.offset = calculatePositionOffset(x, y);
-          if (isEdgeHexagon(x, y)) {
-            edgeInstanceData.push_back(inst);
-          } else {
-            internalInstanceData.push_back(inst);
+          if (simulated) {
+            inst.angle = initialMagnetAngle(x, y);
+          }
+          auto slot = static_cast<uint32_t>(next[variantOf(x, y)]++);
+          instanceData[slot] = inst;
+          cellSlots.push_back(slot);
+          if (simulated) {
+            magnets.push_back(inst);
           }
         }
       }
 
-      createInstanceBuffer(edgeInstanceData, edgeInstanceBuffer, edgeInstanceBufferMemory);
-      createInstanceBuffer(internalInstanceData, internalInstanceBuffer, internalInstanceBufferMemory);
+      updateInstanceBuffer(std::move(instanceData));
+      writeDrawCommands();
+
+      float spacing = glm::length(calculatePositionOffset(1, 0) - calculatePositionOffset(0, 0));
+      if (vulkanSimulation) {
+        vulkanSimulation->setLattice(gridWidth,
+                                     gridHeight,
+                                     magnets,
+                                     cellSlots,
+                                     instanceBuffers.list(),
+                                     spacing,
+                                     *vulkanUploader);
+      } else if (cpuMagnets) {
+        cpuMagnets->setLattice(gridWidth, gridHeight, magnets, cellSlots, spacing);
+      }
+    }
+
+    // The unculled draw: each variant's LOD 0 mesh over all its instances. Queued on the
+    // uploader with the instance data.
+    void writeDrawCommands() {
+      std::array<VkDrawIndexedIndirectCommand, HEX_VARIANT_COUNT> commands{};
+      for (uint32_t v = 0; v < HEX_VARIANT_COUNT; v++) {
+        const MeshRange &mesh = hexGeometry.meshes[v][0];
+        commands[v].indexCount = mesh.indexCount;
+        commands[v].instanceCount = static_cast<uint32_t>(variantRanges[v].end - variantRanges[v].begin);
+        commands[v].firstIndex = mesh.firstIndex;
+        commands[v].vertexOffset = mesh.vertexOffset;
+        commands[v].firstInstance = multiDrawIndirect ? static_cast<uint32_t>(variantRanges[v].begin) : 0;
+      }
+      vulkanUploader->upload(drawCommands, 0, commands.data(), sizeof(commands));
+    }
+
+    // Small deterministic tilt per hex so the lattice does not start balanced on its unstable
+    // all-aligned state.
+    static float initialMagnetAngle(int x, int y) {
+      uint32_t hash = static_cast<uint32_t>(x) * 73856093u ^ static_cast<uint32_t>(y) * 19349663u;
+      hash ^= hash >> 13;
+      hash *= 0x5bd1e995u;
+      hash ^= hash >> 15;
+      return (static_cast<float>(hash & 0xffffu) / 65535.0f - 0.5f) * 0.6f;
     }
 
-    static constexpr int GRID_WIDTH = 10;
-    static constexpr int GRID_HEIGHT = 10;
+    int gridWidth = 10;
+    int gridHeight = 10;
 };
@@ -0,0 +1,341 @@
+//
+// Created by Elijah Crain on 10/17/26.
+//
+#pragma once
+
+#include "VulkanDevice.cpp"
+#include "VulkanPipeline.cpp"
+#include "VulkanUpload.cpp"
+#include "Util.cpp"
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <vector>
+#include <array>
+#include <string>
+#include <memory>
+#include <stdexcept>
+#include <cmath>
+
+// GPU integration of magnet orientations. The lattice state lives in two grid-ordered buffers of
+// InstanceData that are ping-ponged every step, so neighbours are always read from the previous
+// step. Each step also scatters the new orientation into the frame slot's instance buffer the hex
+// is drawn from, so the vertex shader and the cull pass see it without a CPU round trip.
+class VulkanMagnetSimulation {
+  public:
+    static constexpr uint32_t WORKGROUP_SIZE = 256;
+
+    VulkanMagnetSimulation(std::shared_ptr<VulkanDevice> device,
+                           uint32_t maxFramesInFlight,
+                           const MagnetSimulationConfig &config,
+                           const SpirvCode &compShader,
+                           VertexFormat vertexFormat,
+                           VkPipelineCache pipelineCache = VK_NULL_HANDLE)
+      : devicePtr(std::move(device)), config(config), pipelineCache(pipelineCache),
+        specialization(vertexFormat), descriptorSets(2 * maxFramesInFlight) {
+      if (config.stepsPerFrame == 0 || config.timeStep <= 0.0f || config.inertia <= 0.0f) {
+        throw std::runtime_error("invalid magnet simulation parameters!");
+      }
+      VkPhysicalDeviceProperties props;
+      vkGetPhysicalDeviceProperties(devicePtr->getPhysicalDevice(), &props);
+      maxWorkGroupCount = std::to_array(props.limits.maxComputeWorkGroupCount);
+
+      createDescriptorSetLayout();
+      createPipeline(compShader);
+      createDescriptorSets();
+    }
+
+    ~VulkanMagnetSimulation() {
+      destroyBuffers();
+      vkDestroyDescriptorPool(device(), descriptorPool, nullptr);
+      vkDestroyPipeline(device(), pipeline, nullptr);
+      vkDestroyPipelineLayout(device(), pipelineLayout, nullptr);
+      vkDestroyDescriptorSetLayout(device(), descriptorSetLayout, nullptr);
+    }
+
+    // Swaps in a pipeline built from new code and returns the old one, which frames already
+    // recorded may still use; the caller destroys it once they have finished.
+    [[nodiscard]] VkPipeline reloadPipeline(const SpirvCode &compShader) {
+      VkPipeline previous = pipeline;
+      pipeline = createComputePipeline(device(), pipelineCache, pipelineLayout, compShader, &specialization.info);
+      return previous;
+    }
+
+    // Replaces the lattice. `magnets` is in grid order (y * width + x) and `slots` maps each cell
+    // to its index in the instance buffers, one per frame slot. The uploads are queued on
+    // `uploader`; flush it before the next frame. Only call while the device is idle.
+    void setLattice(int width,
+                    int height,
+                    const std::vector<InstanceData> &magnets,
+                    const std::vector<uint32_t> &slots,
+                    const std::vector<VkBuffer> &instances,
+                    float spacing,
+                    VulkanUploader &uploader) {
+      if (magnets.size() != static_cast<size_t>(width) * static_cast<size_t>(height) || slots.size() != magnets.size()) {
+        throw std::runtime_error("magnet lattice does not match its grid size!");
+      }
+      gridWidth = static_cast<uint32_t>(width);
+      gridHeight = static_cast<uint32_t>(height);
+      latticeSpacing = spacing;
+
+      if (magnets.size() > capacity) {
+        destroyBuffers();
+        capacity = magnets.size();
+        for (size_t i = 0; i < state.size(); i++) {
+          devicePtr->createBuffer(sizeof(InstanceData) * capacity,
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                  state[i],
+                                  stateMemory[i]);
+        }
+        devicePtr->createBuffer(sizeof(uint32_t) * capacity,
+                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                slotBuffer,
+                                slotMemory);
+      }
+
+      // Both halves start equal, so the first step reads the initial state whichever way it runs.
+      for (size_t i = 0; i < state.size(); i++) {
+        uploader.upload(state[i], 0, magnets.data(), sizeof(InstanceData) * magnets.size());
+      }
+      uploader.upload(slotBuffer, 0, slots.data(), sizeof(uint32_t) * slots.size());
+
+      if (instances.size() * 2 != descriptorSets.size()) {
+        throw std::runtime_error("magnet simulation needs one instance buffer per frame slot!");
+      }
+      for (uint32_t i = 0; i < descriptorSets.size(); i++) {
+        uint32_t frame = i / 2;
+        uint32_t from = i % 2;
+        updateDescriptorSet(descriptorSets[i],
+                            state[from],
+                            state[1 - from],
+                            instances[frame]);
+      }
+      current = 0;
+    }
+
+    // Records stepsPerFrame steps writing frameIndex's instance buffer. Must be called outside a
+    // render pass; leaves the instance buffer ready for compute reads and vertex input.
+    void record(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+      if (gridWidth == 0 || gridHeight == 0) {
+        return;
+      }
+
+      // Orders the first step after the previous frame's steps. The slot's instance buffer was
+      // last read by the frame whose fence has already been waited on.
+      barrier(commandBuffer,
+              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+              VK_ACCESS_SHADER_WRITE_BIT,
+              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+              VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+      uint32_t magnetCount = gridWidth * gridHeight;
+      for (uint32_t step = 0; step < config.stepsPerFrame; step++) {
+        if (step > 0) {
+          barrier(commandBuffer,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        }
+
+        auto phase = static_cast<float>(2.0 * glm::pi<double>()
+                                        * std::fmod(config.fieldFrequency * simulatedSeconds, 1.0));
+        StepParams params{};
+        params.gridWidth = gridWidth;
+        params.gridHeight = gridHeight;
+        params.timeStep = config.timeStep;
+        params.coupling = config.coupling;
+        params.damping = config.damping;
+        params.inertia = config.inertia;
+        params.spacing = latticeSpacing;
+        params.fieldStrength = config.fieldStrength;
+        params.field = glm::vec2(std::sin(phase), std::cos(phase));
+
+        vkCmdBindDescriptorSets(commandBuffer,
+                                VK_PIPELINE_BIND_POINT_COMPUTE,
+                                pipelineLayout,
+                                0,
+                                1,
+                                &descriptorSets[2 * frameIndex + current],
+                                0,
+                                nullptr);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+        dispatchItems(commandBuffer, magnetCount, WORKGROUP_SIZE, maxWorkGroupCount);
+
+        current = 1 - current;
+        simulatedSeconds += config.timeStep;
+        stepCount++;
+      }
+
+      barrier(commandBuffer,
+              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+              VK_ACCESS_SHADER_WRITE_BIT,
+              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+              VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    }
+
+    [[nodiscard]] uint64_t getStepCount() const { return stepCount; }
+    [[nodiscard]] uint32_t getStepsPerFrame() const { return config.stepsPerFrame; }
+    [[nodiscard]] double getSimulatedSeconds() const { return simulatedSeconds; }
+
+  private:
+    struct StepParams {
+      uint32_t gridWidth;
+      uint32_t gridHeight;
+      float timeStep;
+      float coupling;
+      float damping;
+      float inertia;
+      float spacing;
+      float fieldStrength;
+      glm::vec2 field;
+    };
+
+    std::shared_ptr<VulkanDevice> devicePtr;
+    MagnetSimulationConfig config;
+
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    std::array<uint32_t, 3> maxWorkGroupCount{};
+    // Which layout the instance buffers are written in.
+    InstanceLayoutSpecialization specialization;
+    // descriptorSets[2 * frame + i] reads state[i], writes state[1 - i] and that frame's instances.
+    std::vector<VkDescriptorSet> descriptorSets;
+
+    std::array<VkBuffer, 2> state{VK_NULL_HANDLE, VK_NULL_HANDLE};
+    std::array<GpuAllocation, 2> stateMemory;
+    VkBuffer slotBuffer = VK_NULL_HANDLE;
+    GpuAllocation slotMemory;
+    size_t capacity = 0;
+
+    uint32_t gridWidth = 0;
+    uint32_t gridHeight = 0;
+    float latticeSpacing = 1.0f;
+    uint32_t current = 0;
+    uint64_t stepCount = 0;
+    double simulatedSeconds = 0.0;
+
+    VkDevice device() const { return devicePtr->getDevice(); }
+
+    static void barrier(VkCommandBuffer commandBuffer,
+                        VkPipelineStageFlags srcStage,
+                        VkAccessFlags srcAccess,
+                        VkPipelineStageFlags dstStage,
+                        VkAccessFlags dstAccess) {
+      VkMemoryBarrier memoryBarrier{};
+      memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      memoryBarrier.srcAccessMask = srcAccess;
+      memoryBarrier.dstAccessMask = dstAccess;
+      vkCmdPipelineBarrier(commandBuffer,
+                           srcStage,
+                           dstStage,
+                           0,
+                           1, &memoryBarrier,
+                           0, nullptr,
+                           0, nullptr);
+    }
+
+    void destroyBuffers() {
+      for (size_t i = 0; i < state.size(); i++) {
+        if (state[i] != VK_NULL_HANDLE) {
+          devicePtr->destroyBuffer(state[i], stateMemory[i]);
+        }
+      }
+      if (slotBuffer != VK_NULL_HANDLE) {
+        devicePtr->destroyBuffer(slotBuffer, slotMemory);
+      }
+    }
+
+    void createDescriptorSetLayout() {
+      std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+      for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+      }
+
+      VkDescriptorSetLayoutCreateInfo layoutInfo{};
+      layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+      layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+      layoutInfo.pBindings = bindings.data();
+
+      if (vkCreateDescriptorSetLayout(device(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create magnet descriptor set layout!");
+      }
+    }
+
+    void createPipeline(const SpirvCode &compShader) {
+      VkPushConstantRange pushConstantRange{};
+      pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+      pushConstantRange.offset = 0;
+      pushConstantRange.size = sizeof(StepParams);
+
+      VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+      pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+      pipelineLayoutInfo.setLayoutCount = 1;
+      pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+      pipelineLayoutInfo.pushConstantRangeCount = 1;
+      pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+      if (vkCreatePipelineLayout(device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create magnet pipeline layout!");
+      }
+
+      pipeline = createComputePipeline(device(), pipelineCache, pipelineLayout, compShader, &specialization.info);
+    }
+
+    void createDescriptorSets() {
+      VkDescriptorPoolSize poolSize{};
+      poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      poolSize.descriptorCount = 4 * static_cast<uint32_t>(descriptorSets.size());
+
+      VkDescriptorPoolCreateInfo poolInfo{};
+      poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+      poolInfo.poolSizeCount = 1;
+      poolInfo.pPoolSizes = &poolSize;
+      poolInfo.maxSets = static_cast<uint32_t>(descriptorSets.size());
+
+      if (vkCreateDescriptorPool(device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create magnet descriptor pool!");
+      }
+
+      std::vector<VkDescriptorSetLayout> layouts(descriptorSets.size(), descriptorSetLayout);
+      VkDescriptorSetAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+      allocInfo.descriptorPool = descriptorPool;
+      allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+      allocInfo.pSetLayouts = layouts.data();
+
+      if (vkAllocateDescriptorSets(device(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate magnet descriptor sets!");
+      }
+    }
+
+    void updateDescriptorSet(VkDescriptorSet descriptorSet,
+                             VkBuffer previous,
+                             VkBuffer next,
+                             VkBuffer instances) {
+      std::array<VkDescriptorBufferInfo, 4> bufferInfos{};
+      bufferInfos[0] = {previous, 0, VK_WHOLE_SIZE};
+      bufferInfos[1] = {next, 0, VK_WHOLE_SIZE};
+      bufferInfos[2] = {slotBuffer, 0, VK_WHOLE_SIZE};
+      bufferInfos[3] = {instances, 0, VK_WHOLE_SIZE};
+
+      std::array<VkWriteDescriptorSet, 4> writes{};
+      for (uint32_t i = 0; i < writes.size(); i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = descriptorSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].descriptorCount = 1;
+        writes[i].pBufferInfo = &bufferInfos[i];
+      }
+      vkUpdateDescriptorSets(device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+};
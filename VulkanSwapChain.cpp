@@ -8,14 +8,79 @@
 #include <array>
 #include <stdexcept>
 #include <memory>
+#include <utility>
+#include <algorithm>
+
+// Everything a swapchain generation owns. Kept alive after a recreate until the frames that
+// were recorded against it have finished.
+struct RetiredSwapChain {
+  VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+  std::vector<VkImageView> imageViews;
+  std::vector<VkFramebuffer> framebuffers;
+  VkImage depthImage = VK_NULL_HANDLE;
+  GpuAllocation depthImageMemory;
+  VkImageView depthImageView = VK_NULL_HANDLE;
+  VkImage colorImage = VK_NULL_HANDLE;
+  GpuAllocation colorImageMemory;
+  VkImageView colorImageView = VK_NULL_HANDLE;
+};
+
+// Named trade-offs between input latency, throughput and power, chosen per deployment.
+enum class PresentProfile {
+  Balanced,     // MAILBOX if available, one spare image, 2 frames in flight
+  LowLatency,   // MAILBOX or IMMEDIATE, as few images as the surface allows, 1 frame in flight
+  Throughput,   // MAILBOX or IMMEDIATE with a deeper image queue and 3 frames in flight
+  PowerSaving   // FIFO: vsync-paced, the CPU sleeps in acquire instead of rendering discarded frames
+};
+
+struct PresentProfileSettings {
+  // Tried in order; FIFO, which every surface supports, is the fallback.
+  std::vector<VkPresentModeKHR> presentModes;
+  // Swapchain images requested beyond the surface's minImageCount.
+  uint32_t extraImages = 1;
+  uint32_t framesInFlight = 2;
+};
+
+inline PresentProfileSettings presentProfileSettings(PresentProfile profile) {
+  switch (profile) {
+    case PresentProfile::LowLatency:
+      return {{VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR}, 0, 1};
+    case PresentProfile::Throughput:
+      return {{VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR}, 2, 3};
+    case PresentProfile::PowerSaving:
+      return {{VK_PRESENT_MODE_FIFO_KHR}, 1, 2};
+    default:
+      return {{VK_PRESENT_MODE_MAILBOX_KHR}, 1, 2};
+  }
+}
+
+inline const char *presentProfileName(PresentProfile profile) {
+  switch (profile) {
+    case PresentProfile::LowLatency: return "low-latency";
+    case PresentProfile::Throughput: return "throughput";
+    case PresentProfile::PowerSaving: return "power-saving";
+    default: return "balanced";
+  }
+}
+
+inline const char *presentModeName(VkPresentModeKHR mode) {
+  switch (mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo-relaxed";
+    default: return "other";
+  }
+}
 
 class VulkanSwapChain {
   public:
     VulkanSwapChain(std::shared_ptr<VulkanDevice> device,
                     VkSurfaceKHR surface,
                     uint32_t width,
-                    uint32_t height)
-      : devicePtr(device), surface(surface), width(width), height(height) {
+                    uint32_t height,
+                    PresentProfileSettings settings = presentProfileSettings(PresentProfile::Balanced))
+      : devicePtr(device), surface(surface), width(width), height(height), settings(std::move(settings)) {
       createSwapChain();
       createImageViews();
       createColorResources();
@@ -23,24 +88,19 @@ class VulkanSwapChain {
     }
 
     ~VulkanSwapChain() {
-      cleanup();
+      RetiredSwapChain resources = retire();
+      destroyRetired(resources);
     }
     void createFramebuffers(VkRenderPass renderPass) {
       swapChainFramebuffers.resize(swapChainImageViews.size());
 
       for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-        std::array<VkImageView, 3> attachments = {
-
-          (devicePtr->getMsaaSamples() == VK_SAMPLE_COUNT_1_BIT)
-            ? swapChainImageViews[i]
-            : colorImageView,
-
-          depthImageView,
-
-          (devicePtr->getMsaaSamples() == VK_SAMPLE_COUNT_1_BIT)
-            ? VK_NULL_HANDLE /* not used if no msaa? */
-            : swapChainImageViews[i]
-        };
+        std::vector<VkImageView> attachments;
+        if (devicePtr->getMsaaSamples() == VK_SAMPLE_COUNT_1_BIT) {
+          attachments = {swapChainImageViews[i], depthImageView};
+        } else {
+          attachments = {colorImageView, depthImageView, swapChainImageViews[i]};
+        }
 
         VkFramebufferCreateInfo framebufferInfo{};
         framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -59,91 +119,120 @@ class VulkanSwapChain {
 
     VkFormat getImageFormat() const { return swapChainImageFormat; }
     VkExtent2D getExtent() const { return swapChainExtent; }
+    VkPresentModeKHR getPresentMode() const { return swapChainPresentMode; }
+    uint32_t getImageCount() const { return static_cast<uint32_t>(swapChainImages.size()); }
     VkSwapchainKHR getSwapChain() const { return swapChain; }
 
+    VkImage getImage(uint32_t index) const { return swapChainImages[index]; }
     const std::vector<VkImageView> &getImageViews() const { return swapChainImageViews; }
     const std::vector<VkFramebuffer> &getFramebuffers() const { return swapChainFramebuffers; }
 
     VkImageView getDepthImageView() const { return depthImageView; }
     VkImage getDepthImage() const { return depthImage; }
-    VkDeviceMemory getDepthImageMemory() const { return depthImageMemory; }
+    const GpuAllocation &getDepthImageMemory() const { return depthImageMemory; }
 
     VkImageView getColorImageView() const { return colorImageView; }
     VkImage getColorImage() const { return colorImage; }
-    VkDeviceMemory getColorImageMemory() const { return colorImageMemory; }
+    const GpuAllocation &getColorImageMemory() const { return colorImageMemory; }
 
     VkFormat findDepthFormat() {
-      return findSupportedFormat(
-        {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
-        VK_IMAGE_TILING_OPTIMAL,
-        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
-      );
+      return devicePtr->findDepthFormat();
     }
 
-    void recreate(uint32_t newWidth, uint32_t newHeight) {
+    // Builds the next generation with the current chain as oldSwapchain, so the presentation
+    // engine can hand its images over without the device going idle. The previous generation is
+    // returned rather than destroyed; pass it to destroyRetired once no frame uses it.
+    // Framebuffers still have to be created for the new generation, unless frames use dynamic
+    // rendering.
+    [[nodiscard]] RetiredSwapChain recreate(uint32_t newWidth, uint32_t newHeight) {
       width = newWidth;
       height = newHeight;
-      cleanup();
+      RetiredSwapChain previous = retire();
+
+      try {
+        createSwapChain(previous.swapChain);
+        createImageViews();
+        createColorResources();
+        createDepthResources();
+      } catch (...) {
+        destroyRetired(previous);
+        throw;
+      }
+      return previous;
+    }
 
-      createSwapChain();
-      createImageViews();
-      createColorResources();
-      createDepthResources();
+    void destroyRetired(RetiredSwapChain &resources) {
+      for (auto framebuffer : resources.framebuffers) {
+        vkDestroyFramebuffer(device(), framebuffer, nullptr);
+      }
+
+      for (auto imageView : resources.imageViews) {
+        vkDestroyImageView(device(), imageView, nullptr);
+      }
+
+      vkDestroyImageView(device(), resources.depthImageView, nullptr);
+      devicePtr->destroyImage(resources.depthImage, resources.depthImageMemory);
+
+      vkDestroyImageView(device(), resources.colorImageView, nullptr);
+      devicePtr->destroyImage(resources.colorImage, resources.colorImageMemory);
+
+      if (resources.swapChain != VK_NULL_HANDLE) {
+        vkDestroySwapchainKHR(device(), resources.swapChain, nullptr);
+      }
+      resources = {};
     }
 
   private:
     std::shared_ptr<VulkanDevice> devicePtr;
     VkSurfaceKHR surface;
     uint32_t width, height;
+    PresentProfileSettings settings;
 
     VkSwapchainKHR swapChain = VK_NULL_HANDLE;
     std::vector<VkImage> swapChainImages;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent{};
+    VkPresentModeKHR swapChainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
     std::vector<VkImageView> swapChainImageViews;
 
     std::vector<VkFramebuffer> swapChainFramebuffers;
 
     VkImage depthImage = VK_NULL_HANDLE;
-    VkDeviceMemory depthImageMemory = VK_NULL_HANDLE;
+    GpuAllocation depthImageMemory;
     VkImageView depthImageView = VK_NULL_HANDLE;
 
     VkImage colorImage = VK_NULL_HANDLE;
-    VkDeviceMemory colorImageMemory = VK_NULL_HANDLE;
+    GpuAllocation colorImageMemory;
     VkImageView colorImageView = VK_NULL_HANDLE;
 
-    void cleanup() {
-      for (auto framebuffer : swapChainFramebuffers) {
-        vkDestroyFramebuffer(device(), framebuffer, nullptr);
-      }
-
-      for (auto imageView : swapChainImageViews) {
-        vkDestroyImageView(device(), imageView, nullptr);
-      }
-
-      vkDestroyImageView(device(), depthImageView, nullptr);
-      vkDestroyImage(device(), depthImage, nullptr);
-      vkFreeMemory(device(), depthImageMemory, nullptr);
-
-      vkDestroyImageView(device(), colorImageView, nullptr);
-      vkDestroyImage(device(), colorImage, nullptr);
-      vkFreeMemory(device(), colorImageMemory, nullptr);
-
-      if (swapChain != VK_NULL_HANDLE) {
-        vkDestroySwapchainKHR(device(), swapChain, nullptr);
-      }
+    // Moves the current generation out, leaving this object empty.
+    RetiredSwapChain retire() {
+      RetiredSwapChain resources;
+      resources.swapChain = std::exchange(swapChain, VK_NULL_HANDLE);
+      resources.imageViews = std::move(swapChainImageViews);
+      resources.framebuffers = std::move(swapChainFramebuffers);
+      resources.depthImage = std::exchange(depthImage, VK_NULL_HANDLE);
+      resources.depthImageMemory = std::exchange(depthImageMemory, {});
+      resources.depthImageView = std::exchange(depthImageView, VK_NULL_HANDLE);
+      resources.colorImage = std::exchange(colorImage, VK_NULL_HANDLE);
+      resources.colorImageMemory = std::exchange(colorImageMemory, {});
+      resources.colorImageView = std::exchange(colorImageView, VK_NULL_HANDLE);
+      swapChainImageViews.clear();
+      swapChainFramebuffers.clear();
+      swapChainImages.clear();
+      return resources;
     }
 
     VkDevice device() const { return devicePtr->getDevice(); }
 
-    void createSwapChain() {
+    void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE) {
       SwapChainSupportDetails swapChainSupport = devicePtr->querySwapChainSupport(devicePtr->getPhysicalDevice());
 
       VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
       VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
       VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-      uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+      uint32_t imageCount = swapChainSupport.capabilities.minImageCount + settings.extraImages;
       if (swapChainSupport.capabilities.maxImageCount > 0 &&
         imageCount > swapChainSupport.capabilities.maxImageCount) {
         imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -177,7 +266,7 @@ class VulkanSwapChain {
       createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
       createInfo.presentMode = presentMode;
       createInfo.clipped = VK_TRUE;
-      createInfo.oldSwapchain = VK_NULL_HANDLE;
+      createInfo.oldSwapchain = oldSwapChain;
 
       if (vkCreateSwapchainKHR(device(), &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
         throw std::runtime_error("failed to create swap chain!");
@@ -189,6 +278,7 @@ class VulkanSwapChain {
 
       swapChainImageFormat = surfaceFormat.format;
       swapChainExtent = extent;
+      swapChainPresentMode = presentMode;
     }
 
     void createImageViews() {
@@ -222,121 +312,38 @@ class VulkanSwapChain {
       }
       VkFormat colorFormat = swapChainImageFormat;
 
-      createImage(swapChainExtent.width,
-                  swapChainExtent.height,
-                  devicePtr->getMsaaSamples(),
-                  colorFormat,
-                  VK_IMAGE_TILING_OPTIMAL,
-                  VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                  colorImage,
-                  colorImageMemory);
-
-      colorImageView = createImageView(colorImage,
-                                       colorFormat,
-                                       VK_IMAGE_ASPECT_COLOR_BIT,
-                                       1 /*mipLevels*/);
+      devicePtr->createImage(swapChainExtent.width,
+                             swapChainExtent.height,
+                             devicePtr->getMsaaSamples(),
+                             colorFormat,
+                             VK_IMAGE_TILING_OPTIMAL,
+                             VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             colorImage,
+                             colorImageMemory);
+
+      colorImageView = devicePtr->createImageView(colorImage,
+                                                  colorFormat,
+                                                  VK_IMAGE_ASPECT_COLOR_BIT,
+                                                  1 /*mipLevels*/);
     }
 
     void createDepthResources() {
       VkFormat depthFormat = findDepthFormat();
-      createImage(swapChainExtent.width,
-                  swapChainExtent.height,
-                  devicePtr->getMsaaSamples(),
-                  depthFormat,
-                  VK_IMAGE_TILING_OPTIMAL,
-                  VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                  depthImage,
-                  depthImageMemory);
-
-      depthImageView = createImageView(depthImage,
-                                       depthFormat,
-                                       VK_IMAGE_ASPECT_DEPTH_BIT,
-                                       1 /*mipLevels*/);
-    }
-
-    VkFormat findSupportedFormat(const std::vector<VkFormat> &candidates,
-                                 VkImageTiling tiling,
-                                 VkFormatFeatureFlags features) {
-      for (VkFormat format : candidates) {
-        VkFormatProperties props;
-        vkGetPhysicalDeviceFormatProperties(devicePtr->getPhysicalDevice(), format, &props);
-
-        if (tiling == VK_IMAGE_TILING_LINEAR &&
-          (props.linearTilingFeatures & features) == features) {
-          return format;
-        } else if (tiling == VK_IMAGE_TILING_OPTIMAL &&
-          (props.optimalTilingFeatures & features) == features) {
-          return format;
-        }
-      }
-      throw std::runtime_error("failed to find supported format!");
-    }
-
-    void createImage(uint32_t w,
-                     uint32_t h,
-                     VkSampleCountFlagBits samples,
-                     VkFormat format,
-                     VkImageTiling tiling,
-                     VkImageUsageFlags usage,
-                     VkMemoryPropertyFlags properties,
-                     VkImage &image,
-                     VkDeviceMemory &imageMemory) {
-      VkImageCreateInfo imageInfo{};
-      imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-      imageInfo.imageType = VK_IMAGE_TYPE_2D;
-      imageInfo.extent.width = w;
-      imageInfo.extent.height = h;
-      imageInfo.extent.depth = 1;
-      imageInfo.mipLevels = 1;
-      imageInfo.arrayLayers = 1;
-      imageInfo.format = format;
-      imageInfo.tiling = tiling;
-      imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-      imageInfo.usage = usage;
-      imageInfo.samples = samples;
-      imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-      if (vkCreateImage(device(), &imageInfo, nullptr, &image) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create image!");
-      }
-
-      VkMemoryRequirements memRequirements;
-      vkGetImageMemoryRequirements(device(), image, &memRequirements);
-
-      VkMemoryAllocateInfo allocInfo{};
-      allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      allocInfo.allocationSize = memRequirements.size;
-      allocInfo.memoryTypeIndex = devicePtr->findMemoryType(memRequirements.memoryTypeBits, properties);
-
-      if (vkAllocateMemory(device(), &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
-      }
-
-      vkBindImageMemory(device(), image, imageMemory, 0);
-    }
-
-    VkImageView createImageView(VkImage image,
-                                VkFormat format,
-                                VkImageAspectFlags aspectFlags,
-                                uint32_t mipLevels) {
-      VkImageViewCreateInfo viewInfo{};
-      viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-      viewInfo.image = image;
-      viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-      viewInfo.format = format;
-      viewInfo.subresourceRange.aspectMask = aspectFlags;
-      viewInfo.subresourceRange.baseMipLevel = 0;
-      viewInfo.subresourceRange.levelCount = mipLevels;
-      viewInfo.subresourceRange.baseArrayLayer = 0;
-      viewInfo.subresourceRange.layerCount = 1;
-
-      VkImageView imageView;
-      if (vkCreateImageView(device(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create texture image view!");
-      }
-      return imageView;
+      devicePtr->createImage(swapChainExtent.width,
+                             swapChainExtent.height,
+                             devicePtr->getMsaaSamples(),
+                             depthFormat,
+                             VK_IMAGE_TILING_OPTIMAL,
+                             VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             depthImage,
+                             depthImageMemory);
+
+      depthImageView = devicePtr->createImageView(depthImage,
+                                                  depthFormat,
+                                                  VK_IMAGE_ASPECT_DEPTH_BIT,
+                                                  1 /*mipLevels*/);
     }
 
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &availableFormats) {
@@ -350,9 +357,9 @@ class VulkanSwapChain {
     }
 
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes) {
-      for (const auto &mode : availablePresentModes) {
-        if (mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-          return mode;
+      for (VkPresentModeKHR preferred : settings.presentModes) {
+        if (std::find(availablePresentModes.begin(), availablePresentModes.end(), preferred) != availablePresentModes.end()) {
+          return preferred;
         }
       }
       return VK_PRESENT_MODE_FIFO_KHR;
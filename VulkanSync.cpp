@@ -5,11 +5,19 @@
 
 #include "VulkanDevice.cpp"
 #include <vector>
+#include <array>
 
+// Frame scheduling on one timeline semaphore. Submitting frame N signals N + 1 on the timeline,
+// so "frame N is done" is a single counter read, any queue can wait for it by value, and the
+// frames-in-flight depth is only a number. Binary semaphores remain for the swapchain, whose
+// acquire and present cannot take timeline semaphores.
 class VulkanSync {
   public:
     VulkanSync(std::shared_ptr<VulkanDevice> device, uint32_t maxFramesInFlight)
       : devicePtr(device), maxFramesInFlight(maxFramesInFlight) {
+      if (maxFramesInFlight == 0) {
+        throw std::runtime_error("need at least one frame in flight!");
+      }
       createSyncObjects();
     }
 
@@ -17,8 +25,8 @@ class VulkanSync {
       for (size_t i = 0; i < maxFramesInFlight; i++) {
         vkDestroySemaphore(device(), renderFinishedSemaphores[i], nullptr);
         vkDestroySemaphore(device(), imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(device(), inFlightFences[i], nullptr);
       }
+      vkDestroySemaphore(device(), timeline, nullptr);
     }
 
     VkSemaphore getImageAvailableSemaphore(size_t frameIndex) const {
@@ -29,8 +37,66 @@ class VulkanSync {
       return renderFinishedSemaphores[frameIndex];
     }
 
-    VkFence *getInFlightFence(size_t frameIndex) {
-      return &inFlightFences[frameIndex];
+    VkSemaphore getTimeline() const { return timeline; }
+    // Timeline value that marks `frameNumber` complete.
+    static uint64_t frameValue(uint64_t frameNumber) { return frameNumber + 1; }
+
+    // How many frames the GPU has finished. They finish in submission order, so these are
+    // frames 0 .. count - 1.
+    [[nodiscard]] uint64_t getCompletedFrameCount() const { return devicePtr->getTimelineValue(timeline); }
+    [[nodiscard]] bool isFrameComplete(uint64_t frameNumber) const {
+      return getCompletedFrameCount() >= frameValue(frameNumber);
+    }
+
+    void waitForFrame(uint64_t frameNumber) const {
+      devicePtr->waitTimeline(timeline, frameValue(frameNumber));
+    }
+
+    // Blocks until `frameNumber` may reuse its slot: the frame maxFramesInFlight before it,
+    // which last used the slot, has finished.
+    void waitForSlot(uint64_t frameNumber) const {
+      if (frameNumber >= maxFramesInFlight) {
+        waitForFrame(frameNumber - maxFramesInFlight);
+      }
+    }
+
+    // Submits `frameNumber`'s command buffer, signalling its timeline value. The binary
+    // semaphores are optional and only used when presenting.
+    void submitFrame(VkQueue queue,
+                     VkCommandBuffer commandBuffer,
+                     uint64_t frameNumber,
+                     VkSemaphore waitSemaphore = VK_NULL_HANDLE,
+                     VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                     VkSemaphore signalSemaphore = VK_NULL_HANDLE) const {
+      // Values for binary semaphores are ignored, but the arrays must line up.
+      const uint64_t waitValue = 0;
+      const std::array<uint64_t, 2> signalValues = {frameValue(frameNumber), 0};
+      const std::array<VkSemaphore, 2> signalSemaphores = {timeline, signalSemaphore};
+      const uint32_t signalCount = signalSemaphore != VK_NULL_HANDLE ? 2 : 1;
+
+      VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+      timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+      timelineInfo.waitSemaphoreValueCount = waitSemaphore != VK_NULL_HANDLE ? 1 : 0;
+      timelineInfo.pWaitSemaphoreValues = &waitValue;
+      timelineInfo.signalSemaphoreValueCount = signalCount;
+      timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+      VkSubmitInfo submitInfo{};
+      submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      submitInfo.pNext = &timelineInfo;
+      if (waitSemaphore != VK_NULL_HANDLE) {
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &waitSemaphore;
+        submitInfo.pWaitDstStageMask = &waitStage;
+      }
+      submitInfo.commandBufferCount = 1;
+      submitInfo.pCommandBuffers = &commandBuffer;
+      submitInfo.signalSemaphoreCount = signalCount;
+      submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+      if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit draw command buffer!");
+      }
     }
 
     uint32_t getMaxFramesInFlight() const { return maxFramesInFlight; }
@@ -39,28 +105,23 @@ class VulkanSync {
     std::shared_ptr<VulkanDevice> devicePtr;
     uint32_t maxFramesInFlight;
 
+    VkSemaphore timeline = VK_NULL_HANDLE;
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> inFlightFences;
 
     VkDevice device() const { return devicePtr->getDevice(); }
 
     void createSyncObjects() {
+      timeline = devicePtr->createTimelineSemaphore();
       imageAvailableSemaphores.resize(maxFramesInFlight);
       renderFinishedSemaphores.resize(maxFramesInFlight);
-      inFlightFences.resize(maxFramesInFlight);
 
       VkSemaphoreCreateInfo semaphoreInfo{};
       semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-      VkFenceCreateInfo fenceInfo{};
-      fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-      fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
       for (size_t i = 0; i < maxFramesInFlight; i++) {
         if (vkCreateSemaphore(device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-          vkCreateSemaphore(device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-          vkCreateFence(device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+          vkCreateSemaphore(device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS) {
           throw std::runtime_error("failed to create sync objects for a frame!");
         }
       }
@@ -0,0 +1,181 @@
+//
+// Created by Elijah Crain on 10/17/26.
+//
+#pragma once
+
+#include "VulkanDevice.cpp"
+#include <vector>
+#include <array>
+#include <memory>
+#include <stdexcept>
+#include <cstdint>
+
+// GPU time of one frame, in milliseconds, split around the render pass and its draws.
+struct GpuFrameTimings {
+  uint64_t frameNumber = 0;
+  double simulationMs = 0.0;  // magnet integration steps; 0 when disabled
+  double cullMs = 0.0;        // compute culling before the render pass; 0 when disabled
+  double renderPassMs = 0.0;  // begin of render pass to end, including the MSAA resolve
+  double drawMs = 0.0;        // the lattice's indirect draws
+  double resolveMs = 0.0;     // last draw to end of render pass: resolve and attachment stores
+};
+
+// Timestamp queries around the render pass and each draw. Each frame in flight owns its own
+// query pool; results are read right after that slot's previous frame has been waited on, so reading
+// never stalls and lags the recording frame by the frames-in-flight depth.
+class VulkanTimestamps {
+  public:
+    enum Marker : uint32_t {
+      SIM_BEGIN = 0,
+      CULL_BEGIN,
+      FRAME_BEGIN,
+      DRAW_BEGIN,
+      DRAW_END,
+      FRAME_END,
+      MARKER_COUNT
+    };
+
+    VulkanTimestamps(std::shared_ptr<VulkanDevice> device, uint32_t maxFramesInFlight, size_t historySize = 256)
+      : devicePtr(std::move(device)), maxFramesInFlight(maxFramesInFlight) {
+      VkPhysicalDeviceProperties props;
+      vkGetPhysicalDeviceProperties(devicePtr->getPhysicalDevice(), &props);
+      timestampPeriodNs = props.limits.timestampPeriod;
+
+      uint32_t queueFamilyCount = 0;
+      vkGetPhysicalDeviceQueueFamilyProperties(devicePtr->getPhysicalDevice(), &queueFamilyCount, nullptr);
+      std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+      vkGetPhysicalDeviceQueueFamilyProperties(devicePtr->getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+      uint32_t validBits = queueFamilies[devicePtr->getQueueFamilyIndices().graphicsFamily.value()].timestampValidBits;
+
+      supported = validBits != 0 && timestampPeriodNs > 0.0f;
+      timestampMask = validBits >= 64 ? ~0ULL : ((1ULL << validBits) - 1);
+
+      history.resize(historySize);
+      pending.resize(maxFramesInFlight, false);
+      pendingFrameNumbers.resize(maxFramesInFlight, 0);
+
+      if (supported) {
+        createQueryPools();
+      }
+    }
+
+    ~VulkanTimestamps() {
+      for (auto pool : queryPools) {
+        vkDestroyQueryPool(device(), pool, nullptr);
+      }
+    }
+
+    // Call outside a render pass before any writeTimestamp in this command buffer.
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint64_t frameNumber) {
+      if (!supported) return;
+      vkCmdResetQueryPool(commandBuffer, queryPools[frameIndex], 0, MARKER_COUNT);
+      pending[frameIndex] = true;
+      pendingFrameNumbers[frameIndex] = frameNumber;
+    }
+
+    // A command buffer recorded with beginFrame for this slot is being submitted again as
+    // `frameNumber`; it resets and writes the queries itself, so only the bookkeeping changes.
+    void replayFrame(uint32_t frameIndex, uint64_t frameNumber) {
+      if (!supported) return;
+      pending[frameIndex] = true;
+      pendingFrameNumbers[frameIndex] = frameNumber;
+    }
+
+    void writeTimestamp(VkCommandBuffer commandBuffer,
+                        uint32_t frameIndex,
+                        Marker marker,
+                        VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT) {
+      if (!supported) return;
+      vkCmdWriteTimestamp(commandBuffer, stage, queryPools[frameIndex], marker);
+    }
+
+    // Call once the frame slot's fence has signaled. Never waits: a not-ready result is dropped.
+    void collect(uint32_t frameIndex) {
+      if (!supported || !pending[frameIndex]) return;
+      pending[frameIndex] = false;
+
+      std::array<uint64_t, MARKER_COUNT> ticks{};
+      VkResult result = vkGetQueryPoolResults(device(),
+                                              queryPools[frameIndex],
+                                              0,
+                                              MARKER_COUNT,
+                                              sizeof(ticks),
+                                              ticks.data(),
+                                              sizeof(uint64_t),
+                                              VK_QUERY_RESULT_64_BIT);
+      if (result != VK_SUCCESS) {
+        return;
+      }
+
+      GpuFrameTimings timings;
+      timings.frameNumber = pendingFrameNumbers[frameIndex];
+      timings.simulationMs = elapsedMs(ticks[SIM_BEGIN], ticks[CULL_BEGIN]);
+      timings.cullMs = elapsedMs(ticks[CULL_BEGIN], ticks[FRAME_BEGIN]);
+      timings.renderPassMs = elapsedMs(ticks[FRAME_BEGIN], ticks[FRAME_END]);
+      timings.drawMs = elapsedMs(ticks[DRAW_BEGIN], ticks[DRAW_END]);
+      timings.resolveMs = elapsedMs(ticks[DRAW_END], ticks[FRAME_END]);
+
+      history[historyHead] = timings;
+      historyHead = (historyHead + 1) % history.size();
+      historyCount = std::min(historyCount + 1, history.size());
+    }
+
+    [[nodiscard]] bool isSupported() const { return supported; }
+    [[nodiscard]] size_t size() const { return historyCount; }
+
+    // i = 0 is the most recently collected frame.
+    [[nodiscard]] const GpuFrameTimings &recent(size_t i = 0) const {
+      if (i >= historyCount) {
+        throw std::out_of_range("no GPU timings recorded that far back!");
+      }
+      return history[(historyHead + history.size() - 1 - i) % history.size()];
+    }
+
+    // Collected frames, oldest first.
+    [[nodiscard]] std::vector<GpuFrameTimings> getHistory() const {
+      std::vector<GpuFrameTimings> ordered;
+      ordered.reserve(historyCount);
+      for (size_t i = historyCount; i > 0; i--) {
+        ordered.push_back(recent(i - 1));
+      }
+      return ordered;
+    }
+
+  private:
+    std::shared_ptr<VulkanDevice> devicePtr;
+    uint32_t maxFramesInFlight;
+
+    bool supported = false;
+    float timestampPeriodNs = 0.0f;
+    uint64_t timestampMask = ~0ULL;
+
+    std::vector<VkQueryPool> queryPools;
+    std::vector<bool> pending;
+    std::vector<uint64_t> pendingFrameNumbers;
+
+    std::vector<GpuFrameTimings> history;
+    size_t historyHead = 0;
+    size_t historyCount = 0;
+
+    VkDevice device() const { return devicePtr->getDevice(); }
+
+    double elapsedMs(uint64_t begin, uint64_t end) const {
+      uint64_t ticks = (end - begin) & timestampMask;
+      return static_cast<double>(ticks) * timestampPeriodNs * 1e-6;
+    }
+
+    void createQueryPools() {
+      queryPools.resize(maxFramesInFlight);
+
+      VkQueryPoolCreateInfo poolInfo{};
+      poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+      poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+      poolInfo.queryCount = MARKER_COUNT;
+
+      for (size_t i = 0; i < maxFramesInFlight; i++) {
+        if (vkCreateQueryPool(device(), &poolInfo, nullptr, &queryPools[i]) != VK_SUCCESS) {
+          throw std::runtime_error("failed to create timestamp query pool!");
+        }
+      }
+    }
+};
@@ -0,0 +1,422 @@
+//
+// Created by Elijah Crain on 10/17/26.
+//
+#pragma once
+
+#include "VulkanDevice.cpp"
+#include <vector>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+// Streams data into DEVICE_LOCAL buffers through a persistently mapped staging ring.
+// upload() only memcpys into the ring and queues a copy region; flush() records every queued
+// copy into one command buffer and submits it without waiting. Every batch signals the next value
+// of the uploader's timeline semaphore, and ring space is reclaimed as earlier values are
+// reached, so steady-state streaming never allocates.
+//
+// When the device has a transfer-only queue family the copies run there, followed by a
+// release/acquire ownership transfer to the graphics family. Otherwise they go on the graphics
+// queue with a single barrier; either way work submitted to the graphics queue after flush()
+// sees the data without further synchronization. Other queues wait on getTimeline() for
+// getSubmittedValue().
+class VulkanUploader {
+  public:
+    static constexpr VkDeviceSize DEFAULT_STAGING_SIZE = 8 * 1024 * 1024;
+
+    VulkanUploader(std::shared_ptr<VulkanDevice> device, VkDeviceSize stagingSize = DEFAULT_STAGING_SIZE)
+      : devicePtr(std::move(device)), stagingCapacity(stagingSize) {
+      QueueFamilyIndices families = devicePtr->getQueueFamilyIndices();
+      graphicsFamily = families.graphicsFamily.value();
+      transferFamily = families.transferFamily.value_or(graphicsFamily);
+      transferQueue = devicePtr->getTransferQueue();
+
+      VkPhysicalDeviceProperties props;
+      vkGetPhysicalDeviceProperties(devicePtr->getPhysicalDevice(), &props);
+      copyAlignment = std::max<VkDeviceSize>(16, props.limits.optimalBufferCopyOffsetAlignment);
+
+      createCommandPools();
+      createStagingBuffer();
+      timeline = devicePtr->createTimelineSemaphore();
+    }
+
+    ~VulkanUploader() {
+      waitIdle();
+      vkDestroySemaphore(device(), timeline, nullptr);
+      vkDestroyCommandPool(device(), transferPool, nullptr);
+      if (acquirePool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(device(), acquirePool, nullptr);
+      }
+      devicePtr->destroyBuffer(stagingBuffer, stagingMemory);
+    }
+
+    VulkanUploader(const VulkanUploader &) = delete;
+    VulkanUploader &operator=(const VulkanUploader &) = delete;
+
+    // Creates a DEVICE_LOCAL buffer and queues its initial contents. Usable after the next flush().
+    void createDeviceLocalBuffer(const void *data,
+                                 VkDeviceSize size,
+                                 VkBufferUsageFlags usage,
+                                 VkBuffer &buffer,
+                                 GpuAllocation &bufferMemory) {
+      devicePtr->createBuffer(size,
+                              usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                              buffer,
+                              bufferMemory);
+      upload(buffer, 0, data, size);
+    }
+
+    // Copies `data` into the staging ring and queues a copy to dst. Uploads larger than the ring
+    // are split; if the ring is full the pending batch is flushed and the oldest batch waited on.
+    void upload(VkBuffer dst, VkDeviceSize dstOffset, const void *data, VkDeviceSize size) {
+      const auto *bytes = static_cast<const uint8_t *>(data);
+      while (size > 0) {
+        VkDeviceSize chunk = std::min(size, stagingCapacity);
+        VkDeviceSize stagingOffset = allocate(chunk);
+        memcpy(stagingMapped + stagingOffset, bytes, static_cast<size_t>(chunk));
+
+        VkBufferCopy region{};
+        region.srcOffset = stagingOffset;
+        region.dstOffset = dstOffset;
+        region.size = chunk;
+        queueCopy(dst, region);
+
+        bytes += chunk;
+        dstOffset += chunk;
+        size -= chunk;
+        bytesUploaded += chunk;
+      }
+    }
+
+    // Submits every queued copy as one batch. Does not wait.
+    void flush() {
+      if (pendingCopies.empty()) {
+        return;
+      }
+
+      Batch &batch = acquireBatch();
+      batch.ringBegin = pendingBegin;
+
+      recordTransfer(batch);
+
+      if (hasDedicatedTransfer()) {
+        recordAcquire(batch);
+
+        // The copies signal one value and the acquire half, on the graphics queue so later draws
+        // are ordered after it, waits for it and signals the next.
+        uint64_t copiesDone = ++submittedValue;
+        submit(transferQueue, batch.transferCommands, 0, copiesDone, "failed to submit upload batch!");
+        submit(devicePtr->getGraphicsQueue(), batch.acquireCommands, copiesDone, ++submittedValue,
+               "failed to submit upload ownership transfer!");
+      } else {
+        submit(transferQueue, batch.transferCommands, 0, ++submittedValue, "failed to submit upload batch!");
+      }
+      batch.timelineValue = submittedValue;
+
+      batch.inFlight = true;
+      inFlight.push_back(static_cast<size_t>(&batch - batches.data()));
+      pendingCopies.clear();
+      pendingBegin = ringHead;
+      batchesSubmitted++;
+    }
+
+    // Flushes and blocks until every submitted batch has completed.
+    void waitIdle() {
+      flush();
+      while (!inFlight.empty()) {
+        retireOldest();
+      }
+    }
+
+    [[nodiscard]] bool hasDedicatedTransfer() const { return transferFamily != graphicsFamily; }
+    [[nodiscard]] VkDeviceSize getStagingCapacity() const { return stagingCapacity; }
+    [[nodiscard]] uint64_t getBytesUploaded() const { return bytesUploaded; }
+    [[nodiscard]] uint64_t getBatchesSubmitted() const { return batchesSubmitted; }
+    // Reaches getSubmittedValue() once everything flushed so far has landed.
+    [[nodiscard]] VkSemaphore getTimeline() const { return timeline; }
+    [[nodiscard]] uint64_t getSubmittedValue() const { return submittedValue; }
+
+  private:
+    // Stages whose reads of uploaded buffers must wait for the copies.
+    static constexpr VkPipelineStageFlags CONSUMER_STAGES = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+                                                            | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+                                                            | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+                                                            | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    static constexpr VkAccessFlags CONSUMER_ACCESS = VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+                                                     | VK_ACCESS_INDEX_READ_BIT
+                                                     | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+                                                     | VK_ACCESS_UNIFORM_READ_BIT
+                                                     | VK_ACCESS_SHADER_READ_BIT;
+
+    struct PendingCopy {
+      VkBuffer dst;
+      std::vector<VkBufferCopy> regions;
+    };
+
+    struct Batch {
+      VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+      VkCommandBuffer acquireCommands = VK_NULL_HANDLE;
+      // Timeline value reached once the batch, including any ownership acquire, has completed.
+      uint64_t timelineValue = 0;
+      VkDeviceSize ringBegin = 0;
+      bool inFlight = false;
+    };
+
+    std::shared_ptr<VulkanDevice> devicePtr;
+
+    uint32_t graphicsFamily = 0;
+    uint32_t transferFamily = 0;
+    VkQueue transferQueue = VK_NULL_HANDLE;
+    VkCommandPool transferPool = VK_NULL_HANDLE;
+    VkCommandPool acquirePool = VK_NULL_HANDLE;
+    VkSemaphore timeline = VK_NULL_HANDLE;
+    uint64_t submittedValue = 0;
+
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    GpuAllocation stagingMemory;
+    uint8_t *stagingMapped = nullptr;
+    VkDeviceSize stagingCapacity;
+    VkDeviceSize copyAlignment = 16;
+
+    // Live data occupies [ringTail, ringHead) modulo the capacity; ringEmpty disambiguates
+    // head == tail. The pending batch starts at pendingBegin.
+    VkDeviceSize ringHead = 0;
+    VkDeviceSize ringTail = 0;
+    VkDeviceSize pendingBegin = 0;
+    bool ringEmpty = true;
+
+    std::vector<PendingCopy> pendingCopies;
+    std::vector<Batch> batches;
+    std::deque<size_t> inFlight;
+
+    uint64_t bytesUploaded = 0;
+    uint64_t batchesSubmitted = 0;
+
+    VkDevice device() const { return devicePtr->getDevice(); }
+
+    void createCommandPools() {
+      VkCommandPoolCreateInfo poolInfo{};
+      poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+      poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+      poolInfo.queueFamilyIndex = transferFamily;
+      if (vkCreateCommandPool(device(), &poolInfo, nullptr, &transferPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload command pool!");
+      }
+
+      if (hasDedicatedTransfer()) {
+        poolInfo.queueFamilyIndex = graphicsFamily;
+        if (vkCreateCommandPool(device(), &poolInfo, nullptr, &acquirePool) != VK_SUCCESS) {
+          throw std::runtime_error("failed to create upload command pool!");
+        }
+      }
+    }
+
+    void createStagingBuffer() {
+      devicePtr->createBuffer(stagingCapacity,
+                              VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              stagingBuffer,
+                              stagingMemory);
+      stagingMapped = static_cast<uint8_t *>(stagingMemory.mapped);
+    }
+
+    // Reserves `size` bytes of ring space, flushing and waiting on old batches until it fits.
+    VkDeviceSize allocate(VkDeviceSize size) {
+      for (;;) {
+        if (ringEmpty) {
+          ringHead = ringTail = pendingBegin = 0;
+        }
+        VkDeviceSize offset = (ringHead + copyAlignment - 1) & ~(copyAlignment - 1);
+
+        if (ringEmpty || ringHead > ringTail) {
+          if (offset + size <= stagingCapacity) {
+            return commit(offset, size);
+          }
+          // Wrap: the tail end of the ring is left unused until the batches before it retire.
+          if (!ringEmpty && size < ringTail) {
+            return commit(0, size);
+          }
+        } else if (offset + size < ringTail) {
+          return commit(offset, size);
+        }
+
+        if (inFlight.empty()) {
+          flush();
+        }
+        retireOldest();
+      }
+    }
+
+    VkDeviceSize commit(VkDeviceSize offset, VkDeviceSize size) {
+      if (pendingCopies.empty()) {
+        pendingBegin = offset;
+      }
+      ringHead = offset + size;
+      ringEmpty = false;
+      return offset;
+    }
+
+    void retireOldest() {
+      Batch &batch = batches[inFlight.front()];
+      devicePtr->waitTimeline(timeline, batch.timelineValue);
+      batch.inFlight = false;
+      inFlight.pop_front();
+
+      if (!inFlight.empty()) {
+        ringTail = batches[inFlight.front()].ringBegin;
+      } else if (!pendingCopies.empty()) {
+        ringTail = pendingBegin;
+      } else {
+        ringEmpty = true;
+      }
+    }
+
+    void queueCopy(VkBuffer dst, const VkBufferCopy &region) {
+      auto it = std::find_if(pendingCopies.begin(), pendingCopies.end(),
+                             [dst](const PendingCopy &copy) { return copy.dst == dst; });
+      if (it == pendingCopies.end()) {
+        pendingCopies.push_back({dst, {region}});
+      } else {
+        it->regions.push_back(region);
+      }
+    }
+
+    Batch &acquireBatch() {
+      for (auto &batch : batches) {
+        if (!batch.inFlight) {
+          return batch;
+        }
+      }
+
+      Batch batch{};
+      VkCommandBufferAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+      allocInfo.commandBufferCount = 1;
+      allocInfo.commandPool = transferPool;
+      if (vkAllocateCommandBuffers(device(), &allocInfo, &batch.transferCommands) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate upload command buffer!");
+      }
+      if (hasDedicatedTransfer()) {
+        allocInfo.commandPool = acquirePool;
+        if (vkAllocateCommandBuffers(device(), &allocInfo, &batch.acquireCommands) != VK_SUCCESS) {
+          throw std::runtime_error("failed to allocate upload command buffer!");
+        }
+      }
+
+      // inFlight holds indices, so growing the vector does not invalidate it.
+      batches.push_back(batch);
+      return batches.back();
+    }
+
+    // Submits one command buffer that signals `signalValue` on the timeline, after waiting for
+    // `waitValue` unless it is 0.
+    void submit(VkQueue queue, VkCommandBuffer commandBuffer, uint64_t waitValue, uint64_t signalValue,
+                const char *error) const {
+      VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+      timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+      timelineInfo.waitSemaphoreValueCount = waitValue != 0 ? 1 : 0;
+      timelineInfo.pWaitSemaphoreValues = &waitValue;
+      timelineInfo.signalSemaphoreValueCount = 1;
+      timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+      VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+      VkSubmitInfo submitInfo{};
+      submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      submitInfo.pNext = &timelineInfo;
+      if (waitValue != 0) {
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &timeline;
+        submitInfo.pWaitDstStageMask = &waitStage;
+      }
+      submitInfo.commandBufferCount = 1;
+      submitInfo.pCommandBuffers = &commandBuffer;
+      submitInfo.signalSemaphoreCount = 1;
+      submitInfo.pSignalSemaphores = &timeline;
+      if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error(error);
+      }
+    }
+
+    VkBufferMemoryBarrier ownershipBarrier(VkBuffer buffer, VkAccessFlags src, VkAccessFlags dst) const {
+      VkBufferMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+      barrier.srcAccessMask = src;
+      barrier.dstAccessMask = dst;
+      barrier.srcQueueFamilyIndex = hasDedicatedTransfer() ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = hasDedicatedTransfer() ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+      barrier.buffer = buffer;
+      barrier.offset = 0;
+      barrier.size = VK_WHOLE_SIZE;
+      return barrier;
+    }
+
+    static void beginOneTime(VkCommandBuffer commandBuffer) {
+      VkCommandBufferBeginInfo beginInfo{};
+      beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+      if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin upload command buffer!");
+      }
+    }
+
+    void recordTransfer(const Batch &batch) {
+      beginOneTime(batch.transferCommands);
+
+      std::vector<VkBufferMemoryBarrier> barriers;
+      barriers.reserve(pendingCopies.size());
+      for (const auto &copy : pendingCopies) {
+        vkCmdCopyBuffer(batch.transferCommands,
+                        stagingBuffer,
+                        copy.dst,
+                        static_cast<uint32_t>(copy.regions.size()),
+                        copy.regions.data());
+        // Release half of the ownership transfer, or the plain visibility barrier.
+        barriers.push_back(ownershipBarrier(copy.dst,
+                                            VK_ACCESS_TRANSFER_WRITE_BIT,
+                                            hasDedicatedTransfer() ? 0 : CONSUMER_ACCESS));
+      }
+
+      // A release only has to be ordered before the semaphore signal; the acquire waits instead.
+      VkPipelineStageFlags dstStage = hasDedicatedTransfer()
+                                        ? static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT)
+                                        : CONSUMER_STAGES;
+      vkCmdPipelineBarrier(batch.transferCommands,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           dstStage,
+                           0,
+                           0, nullptr,
+                           static_cast<uint32_t>(barriers.size()), barriers.data(),
+                           0, nullptr);
+
+      if (vkEndCommandBuffer(batch.transferCommands) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record upload command buffer!");
+      }
+    }
+
+    void recordAcquire(const Batch &batch) {
+      beginOneTime(batch.acquireCommands);
+
+      std::vector<VkBufferMemoryBarrier> barriers;
+      barriers.reserve(pendingCopies.size());
+      for (const auto &copy : pendingCopies) {
+        barriers.push_back(ownershipBarrier(copy.dst, 0, CONSUMER_ACCESS));
+      }
+
+      vkCmdPipelineBarrier(batch.acquireCommands,
+                           VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                           CONSUMER_STAGES,
+                           0,
+                           0, nullptr,
+                           static_cast<uint32_t>(barriers.size()), barriers.data(),
+                           0, nullptr);
+
+      if (vkEndCommandBuffer(batch.acquireCommands) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record upload command buffer!");
+      }
+    }
+};
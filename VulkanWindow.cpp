@@ -19,18 +19,32 @@ class VulkanWindow {
       initWindow();
     }
 
+    // Headless window: carries the camera state and extent but never touches GLFW.
+    VulkanWindow(uint32_t width, uint32_t height)
+      : width(width), height(height), title(nullptr) {
+    }
+
     ~VulkanWindow() {
       cleanup();
     }
 
     void pollEvents() {
-      glfwPollEvents();
+      if (window != nullptr) {
+        glfwPollEvents();
+      }
     }
 
     bool shouldClose() const {
-      return glfwWindowShouldClose(window);
+      return window != nullptr && glfwWindowShouldClose(window);
     }
 
+    bool isHeadless() const {
+      return window == nullptr;
+    }
+
+    uint32_t getWidth() const { return width; }
+    uint32_t getHeight() const { return height; }
+
     GLFWwindow *getGLFWwindow() const {
       return window;
     }
@@ -114,6 +128,9 @@ class VulkanWindow {
     }
 
     void cleanup() {
+      if (window == nullptr) {
+        return;
+      }
       glfwDestroyWindow(window);
       glfwTerminate();
     }
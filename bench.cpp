@@ -0,0 +1,555 @@
+//
+// Created by Elijah Crain on 10/17/26.
+//
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "VulkanWindow.cpp"
+#include "VulkanRenderer.cpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstdint>
+#include <memory>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <numeric>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+// Frame-time benchmark: drives VulkanRenderer::drawFrame for a fixed number of frames along a
+// scripted camera path and prints a JSON report. Headless by default so it runs on render nodes.
+//
+//   VulkanMagnets_bench [--frames N] [--warmup N] [--grid W[xH]] [--msaa 1|2|4|8|...]
+//                       [--size WxH] [--windowed] [--out file.json]
+//                       [--sweep W[xH],W[xH],...] [--no-cull] [--lod PX0,PX1 | --no-lod]
+//                       [--sim-steps N] [--cpu-sim [--sim-threads N] | --no-sim]
+//                       [--edit-fraction F] [--pipeline-cache FILE | --no-pipeline-cache]
+//                       [--record-threads N] [--frames-in-flight N]
+//                       [--present-profile balanced|low-latency|throughput|power-saving]
+//                       [--vertex-format compact|full] [--no-mesh-opt] [--static-commands]
+//                       [--dynamic-rendering]
+//
+// --sweep re-runs the measurement at each listed lattice size after the main run and adds a
+// "scaling" section, e.g. --sweep 100,316,1000,3162 covers 10^4 to 10^7 instances.
+// --lod sets the projected diameters (pixels) below which hexes drop to LOD 1 and LOD 2;
+// --no-lod draws everything at full detail.
+// --sim-steps sets magnet integration steps per frame; the "simulation" section reports steps
+// per second and nanoseconds per magnet update of the solver, e.g. --grid 1000 --sim-steps 8 for
+// 10^6 magnets. --cpu-sim switches to the multithreaded CPU solver.
+// --edit-fraction retilts that fraction of the magnets from the CPU every frame; with --no-sim
+// the "instance_upload" section shows how many bytes the dirty ranges actually copied.
+// "startup" times init and the first frame; run twice to compare a cold pipeline cache with a
+// warm one, or pass --no-pipeline-cache to measure without it. The cache defaults to the per-user
+// cache directory (defaultPipelineCachePath); --pipeline-cache points it elsewhere.
+// --record-threads records the indirect draws into secondary command buffers on N threads (0 for
+// one per hardware thread, at most one per draw job; only without multi-draw indirect is there
+// more than one job); compare ms.record against the default inline recording.
+// --frames-in-flight sets how many frames the CPU may record ahead of the GPU (default: the
+// present profile's). --present-profile picks the present mode and queue depths; "bound" counts
+// the frames that waited on the GPU longer than they spent on the CPU, a high gpu_bound_fraction
+// favouring low-latency and a low one throughput.
+// --vertex-format full switches back to 32-bit float vertices and instances to measure what the
+// compact half-float layout saves in bandwidth.
+// The "meshes" section gives each hex mesh's vertex count, ACMR (vertex shader runs per
+// triangle) and ATVR (runs per unique vertex) before and after the startup mesh optimizer;
+// --no-mesh-opt draws the meshes as generated.
+// --static-commands records each frame slot's command buffer once and replays it while only the
+// camera moves; use it with --no-sim and compare ms.record. "commands" counts recorded and
+// replayed frames.
+// --dynamic-rendering renders without a render pass or framebuffers where VK_KHR_dynamic_rendering
+// is available; "dynamic_rendering" says whether it was.
+
+struct BenchOptions {
+  uint32_t frames = 1000;
+  uint32_t warmupFrames = 60;
+  uint32_t width = 800;
+  uint32_t height = 600;
+  RendererConfig renderer{};
+  bool windowed = false;
+  std::string outPath;
+  std::vector<std::pair<int, int>> sweep;
+  double editFraction = 0.0;
+};
+
+struct Summary {
+  double mean = 0.0;
+  double p50 = 0.0;
+  double p95 = 0.0;
+  double p99 = 0.0;
+  double min = 0.0;
+  double max = 0.0;
+};
+
+static Summary summarize(std::vector<double> samples) {
+  Summary summary;
+  if (samples.empty()) {
+    return summary;
+  }
+  std::sort(samples.begin(), samples.end());
+  auto percentile = [&](double p) {
+    size_t rank = static_cast<size_t>(p * static_cast<double>(samples.size() - 1) + 0.5);
+    return samples[std::min(rank, samples.size() - 1)];
+  };
+  summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+  summary.p50 = percentile(0.50);
+  summary.p95 = percentile(0.95);
+  summary.p99 = percentile(0.99);
+  summary.min = samples.front();
+  summary.max = samples.back();
+  return summary;
+}
+
+static void writeSummary(std::ostream &out, const char *name, const Summary &s, bool last = false) {
+  out << "    \"" << name << "\": {"
+      << "\"mean\": " << s.mean << ", "
+      << "\"p50\": " << s.p50 << ", "
+      << "\"p95\": " << s.p95 << ", "
+      << "\"p99\": " << s.p99 << ", "
+      << "\"min\": " << s.min << ", "
+      << "\"max\": " << s.max << "}" << (last ? "\n" : ",\n");
+}
+
+static void writeMeshStats(std::ostream &out, const MeshStats &stats) {
+  out << "{\"vertices\": " << stats.vertexCount << ", "
+      << "\"triangles\": " << stats.triangleCount << ", "
+      << "\"acmr\": " << stats.acmr << ", "
+      << "\"atvr\": " << stats.atvr << "}";
+}
+
+// Deterministic orbit: one full turn around the lattice over the run, with the polar angle,
+// radius and fov swept so both wide and narrow views are covered.
+static void applyCameraPath(VulkanWindow &window, uint32_t frame, uint32_t frameCount) {
+  const float t = static_cast<float>(frame) / static_cast<float>(std::max(frameCount, 1u));
+  const float phase = glm::two_pi<float>() * t;
+
+  window.cameraAngleX = phase;
+  window.cameraAngleY = glm::radians(90.0f) - glm::radians(60.0f) * (0.5f - 0.5f * cos(phase));
+  window.radius = 20.0f + 5.0f * sin(2.0f * phase);
+  window.fov = 5.0f + 20.0f * (0.5f - 0.5f * cos(phase));
+}
+
+static VkSampleCountFlagBits parseSampleCount(const std::string &value) {
+  switch (std::stoi(value)) {
+    case 1: return VK_SAMPLE_COUNT_1_BIT;
+    case 2: return VK_SAMPLE_COUNT_2_BIT;
+    case 4: return VK_SAMPLE_COUNT_4_BIT;
+    case 8: return VK_SAMPLE_COUNT_8_BIT;
+    case 16: return VK_SAMPLE_COUNT_16_BIT;
+    case 32: return VK_SAMPLE_COUNT_32_BIT;
+    case 64: return VK_SAMPLE_COUNT_64_BIT;
+    default: throw std::runtime_error("--msaa must be a power of two between 1 and 64!");
+  }
+}
+
+static void parseSize(const std::string &value, int &w, int &h) {
+  auto x = value.find('x');
+  w = std::stoi(value.substr(0, x));
+  h = (x == std::string::npos) ? w : std::stoi(value.substr(x + 1));
+  if (w <= 0 || h <= 0) {
+    throw std::runtime_error("sizes must be positive!");
+  }
+}
+
+static PresentProfile parsePresentProfile(const std::string &value) {
+  for (PresentProfile profile : {PresentProfile::Balanced, PresentProfile::LowLatency,
+                                 PresentProfile::Throughput, PresentProfile::PowerSaving}) {
+    if (value == presentProfileName(profile)) {
+      return profile;
+    }
+  }
+  throw std::runtime_error("unknown present profile " + value);
+}
+
+static VertexFormat parseVertexFormat(const std::string &value) {
+  for (VertexFormat format : {VertexFormat::Compact, VertexFormat::Full}) {
+    if (value == vertexFormatName(format)) {
+      return format;
+    }
+  }
+  throw std::runtime_error("unknown vertex format " + value);
+}
+
+static BenchOptions parseOptions(int argc, char **argv) {
+  BenchOptions options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("missing value for " + arg);
+      }
+      return argv[++i];
+    };
+
+    if (arg == "--frames") {
+      options.frames = static_cast<uint32_t>(std::stoul(next()));
+    } else if (arg == "--warmup") {
+      options.warmupFrames = static_cast<uint32_t>(std::stoul(next()));
+    } else if (arg == "--grid") {
+      parseSize(next(), options.renderer.gridWidth, options.renderer.gridHeight);
+    } else if (arg == "--msaa") {
+      options.renderer.maxMsaaSamples = parseSampleCount(next());
+    } else if (arg == "--size") {
+      int w, h;
+      parseSize(next(), w, h);
+      options.width = static_cast<uint32_t>(w);
+      options.height = static_cast<uint32_t>(h);
+    } else if (arg == "--no-cull") {
+      options.renderer.gpuCulling = false;
+    } else if (arg == "--lod") {
+      std::string value = next();
+      size_t comma = value.find(',');
+      if (comma == std::string::npos) {
+        throw std::runtime_error("expected PX0,PX1 for --lod, got " + value);
+      }
+      options.renderer.lodScreenSizes = {std::stof(value.substr(0, comma)), std::stof(value.substr(comma + 1))};
+    } else if (arg == "--no-lod") {
+      options.renderer.lodScreenSizes = {0.0f, 0.0f};
+    } else if (arg == "--sim-steps") {
+      options.renderer.magnets.stepsPerFrame = static_cast<uint32_t>(std::stoul(next()));
+    } else if (arg == "--cpu-sim") {
+      options.renderer.magnetBackend = MagnetBackend::Cpu;
+    } else if (arg == "--sim-threads") {
+      options.renderer.cpuSolverThreads = static_cast<uint32_t>(std::stoul(next()));
+    } else if (arg == "--no-sim") {
+      options.renderer.magnetBackend = MagnetBackend::None;
+    } else if (arg == "--edit-fraction") {
+      options.editFraction = std::stod(next());
+      if (options.editFraction < 0.0 || options.editFraction > 1.0) {
+        throw std::runtime_error("--edit-fraction must be between 0 and 1!");
+      }
+    } else if (arg == "--pipeline-cache") {
+      options.renderer.pipelineCachePath = next();
+    } else if (arg == "--no-pipeline-cache") {
+      options.renderer.pipelineCachePath.clear();
+    } else if (arg == "--record-threads") {
+      options.renderer.recordingThreads = static_cast<uint32_t>(std::stoul(next()));
+    } else if (arg == "--frames-in-flight") {
+      options.renderer.framesInFlight = static_cast<uint32_t>(std::stoul(next()));
+    } else if (arg == "--present-profile") {
+      options.renderer.presentProfile = parsePresentProfile(next());
+    } else if (arg == "--static-commands") {
+      options.renderer.staticCommandBuffers = true;
+    } else if (arg == "--dynamic-rendering") {
+      options.renderer.dynamicRendering = true;
+    } else if (arg == "--no-mesh-opt") {
+      options.renderer.optimizeMeshes = false;
+    } else if (arg == "--vertex-format") {
+      options.renderer.vertexFormat = parseVertexFormat(next());
+    } else if (arg == "--windowed") {
+      options.windowed = true;
+    } else if (arg == "--out") {
+      options.outPath = next();
+    } else if (arg == "--sweep") {
+      std::stringstream list(next());
+      std::string item;
+      while (std::getline(list, item, ',')) {
+        int w, h;
+        parseSize(item, w, h);
+        options.sweep.emplace_back(w, h);
+      }
+    } else {
+      throw std::runtime_error("unknown argument: " + arg);
+    }
+  }
+  return options;
+}
+
+// CPU samples of one measured run; GPU timings are matched by frame number afterwards.
+struct RunSamples {
+  std::vector<double> cpuFrameMs, simulateMs, fenceWaitMs, acquireMs, recordMs, submitMs, presentMs;
+  std::vector<double> instanceUploadBytes;
+  uint64_t gpuBoundFrames = 0;
+  uint64_t firstFrame = 0;
+  uint64_t endFrame = 0;
+  uint64_t simulationSteps = 0;
+  uint64_t cpuSolveNs = 0;
+  double wallSeconds = 0.0;
+};
+
+// Retilts options.editFraction of the magnets at pseudo-random cells. The generator is a fixed
+// LCG so runs edit the same cells in the same order.
+static void editMagnets(VulkanRenderer &renderer, const BenchOptions &options, uint32_t &seed) {
+  const int width = renderer.getGridWidth();
+  const int height = renderer.getGridHeight();
+  const auto edits = static_cast<size_t>(options.editFraction * static_cast<double>(renderer.getInstanceCount()));
+  for (size_t e = 0; e < edits; e++) {
+    seed = seed * 1664525u + 1013904223u;
+    uint32_t cell = seed % static_cast<uint32_t>(width * height);
+    float angle = (static_cast<float>(seed >> 16) / 65535.0f - 0.5f) * glm::pi<float>();
+    renderer.setMagnetAngle(static_cast<int>(cell % width), static_cast<int>(cell / width), angle);
+  }
+}
+
+static RunSamples runFrames(VulkanRenderer &renderer, VulkanWindow &window, const BenchOptions &options) {
+  uint32_t seed = 1;
+  for (uint32_t i = 0; i < options.warmupFrames; i++) {
+    applyCameraPath(window, i, options.warmupFrames);
+    window.pollEvents();
+    editMagnets(renderer, options, seed);
+    renderer.drawFrame();
+  }
+
+  RunSamples run;
+  run.cpuFrameMs.reserve(options.frames);
+  run.firstFrame = renderer.getFrameNumber();
+  uint64_t firstStep = renderer.getSimulationStepCount();
+  uint64_t firstSolveNs = renderer.getCpuSolveNanoseconds();
+
+  auto runStart = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < options.frames && !window.shouldClose(); i++) {
+    applyCameraPath(window, i, options.frames);
+    window.pollEvents();
+    editMagnets(renderer, options, seed);
+
+    auto frameStart = std::chrono::steady_clock::now();
+    renderer.drawFrame();
+    auto frameEnd = std::chrono::steady_clock::now();
+
+    const FrameTimings &timings = renderer.getFrameTimings();
+    run.cpuFrameMs.push_back(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+    run.simulateMs.push_back(timings.simulateMs);
+    run.fenceWaitMs.push_back(timings.fenceWaitMs);
+    run.acquireMs.push_back(timings.acquireMs);
+    run.recordMs.push_back(timings.recordMs);
+    run.submitMs.push_back(timings.submitMs);
+    run.presentMs.push_back(timings.presentMs);
+    run.instanceUploadBytes.push_back(static_cast<double>(timings.instanceUploadBytes));
+    run.gpuBoundFrames += timings.gpuBound ? 1 : 0;
+  }
+  vkDeviceWaitIdle(renderer.getDevice());
+  renderer.flushGpuTimings();
+  run.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+  run.endFrame = renderer.getFrameNumber();
+  run.simulationSteps = renderer.getSimulationStepCount() - firstStep;
+  run.cpuSolveNs = renderer.getCpuSolveNanoseconds() - firstSolveNs;
+  return run;
+}
+
+// Integration steps per second of solver time: GPU time in the simulation pass, or CPU time in
+// the solver's step().
+static double solverStepsPerSecond(const VulkanRenderer &renderer,
+                                   const BenchOptions &options,
+                                   const RunSamples &run,
+                                   const std::vector<GpuFrameTimings> &timings) {
+  if (options.renderer.magnetBackend == MagnetBackend::Cpu) {
+    return run.cpuSolveNs > 0 ? static_cast<double>(run.simulationSteps) / (static_cast<double>(run.cpuSolveNs) * 1e-9) : 0.0;
+  }
+  double simulationMs = 0.0;
+  for (const auto &gpu : timings) {
+    simulationMs += gpu.simulationMs;
+  }
+  if (simulationMs <= 0.0) {
+    return 0.0;
+  }
+  return static_cast<double>(timings.size()) * renderer.getSimulationStepsPerFrame() / (simulationMs * 1e-3);
+}
+
+static const char *backendName(MagnetBackend backend) {
+  switch (backend) {
+    case MagnetBackend::Gpu: return "gpu";
+    case MagnetBackend::Cpu: return "cpu";
+    default: return "none";
+  }
+}
+
+// GPU timestamps lag by the frames in flight; only frames from the measured run count.
+static std::vector<GpuFrameTimings> gpuTimingsFor(const VulkanRenderer &renderer, const RunSamples &run) {
+  std::vector<GpuFrameTimings> timings;
+  for (const auto &gpu : renderer.getGpuTimestamps().getHistory()) {
+    if (gpu.frameNumber >= run.firstFrame && gpu.frameNumber < run.endFrame) {
+      timings.push_back(gpu);
+    }
+  }
+  return timings;
+}
+
+int main(int argc, char **argv) {
+  try {
+    BenchOptions options = parseOptions(argc, argv);
+    options.renderer.gpuTimingHistory = (options.warmupFrames + options.frames) * (1 + options.sweep.size());
+
+    std::shared_ptr<VulkanWindow> window;
+    if (options.windowed) {
+      window = std::make_shared<VulkanWindow>(options.width, options.height, "VulkanMagnets bench");
+    } else {
+      window = std::make_shared<VulkanWindow>(options.width, options.height);
+    }
+
+    auto startupBegin = std::chrono::steady_clock::now();
+    VulkanRenderer renderer{};
+    renderer.init(window, options.width, options.height, options.renderer);
+    double initMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count();
+    renderer.drawFrame();
+    vkDeviceWaitIdle(renderer.getDevice());
+    double firstFrameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count();
+
+    RunSamples run = runFrames(renderer, *window, options);
+
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"config\": {"
+         << "\"frames\": " << run.cpuFrameMs.size() << ", "
+         << "\"warmup_frames\": " << options.warmupFrames << ", "
+         << "\"grid_width\": " << options.renderer.gridWidth << ", "
+         << "\"grid_height\": " << options.renderer.gridHeight << ", "
+         << "\"instances\": " << renderer.getInstanceCount() << ", "
+         << "\"msaa_samples\": " << static_cast<uint32_t>(renderer.getMsaaSamples()) << ", "
+         << "\"width\": " << options.width << ", "
+         << "\"height\": " << options.height << ", "
+         << "\"gpu_culling\": " << (options.renderer.gpuCulling ? "true" : "false") << ", "
+         << "\"multi_draw_indirect\": " << (renderer.usesMultiDrawIndirect() ? "true" : "false") << ", "
+         << "\"indirect_commands\": " << renderer.getIndirectCommandCount() << ", "
+         << "\"vertex_format\": \"" << vertexFormatName(renderer.getVertexFormat()) << "\", "
+         << "\"lod_screen_sizes\": [" << options.renderer.lodScreenSizes[0] << ", "
+         << options.renderer.lodScreenSizes[1] << "], "
+         << "\"magnet_backend\": \"" << backendName(options.renderer.magnetBackend) << "\", "
+         << "\"sim_steps_per_frame\": " << renderer.getSimulationStepsPerFrame() << ", "
+         << "\"recording_threads\": " << renderer.getRecordingThreads() << ", "
+         << "\"static_command_buffers\": " << (renderer.usesStaticCommandBuffers() ? "true" : "false") << ", "
+         << "\"dynamic_rendering\": " << (renderer.usesDynamicRendering() ? "true" : "false") << ", "
+         << "\"frames_in_flight\": " << renderer.getFramesInFlight() << ", "
+         << "\"present_profile\": \"" << presentProfileName(renderer.getPresentProfile()) << "\", "
+         << "\"present_mode\": \"" << renderer.getPresentModeName() << "\", "
+         << "\"headless\": " << (renderer.isHeadless() ? "true" : "false") << "},\n"
+         << "  \"startup\": {"
+         << "\"init_ms\": " << initMs << ", "
+         << "\"first_frame_ms\": " << firstFrameMs << ", "
+         << "\"pipeline_cache_loaded_bytes\": " << renderer.getPipelineCacheLoadedBytes() << "},\n"
+         << "  \"wall_seconds\": " << run.wallSeconds << ",\n"
+         << "  \"fps\": " << static_cast<double>(run.cpuFrameMs.size()) / run.wallSeconds << ",\n"
+         << "  \"bound\": {"
+         << "\"gpu_bound_frames\": " << run.gpuBoundFrames << ", "
+         << "\"cpu_bound_frames\": " << run.cpuFrameMs.size() - run.gpuBoundFrames << ", "
+         << "\"gpu_bound_fraction\": "
+         << (run.cpuFrameMs.empty() ? 0.0 : static_cast<double>(run.gpuBoundFrames) / static_cast<double>(run.cpuFrameMs.size()))
+         << "},\n"
+         << "  \"ms\": {\n";
+    writeSummary(json, "cpu_frame", summarize(run.cpuFrameMs));
+    writeSummary(json, "simulate", summarize(run.simulateMs));
+    writeSummary(json, "fence_wait", summarize(run.fenceWaitMs));
+    writeSummary(json, "acquire", summarize(run.acquireMs));
+    writeSummary(json, "record", summarize(run.recordMs));
+    writeSummary(json, "submit", summarize(run.submitMs));
+    writeSummary(json, "present", summarize(run.presentMs), true);
+    json << "  },\n";
+
+    std::vector<GpuFrameTimings> runGpuTimings = gpuTimingsFor(renderer, run);
+    std::vector<double> gpuSimMs, gpuCullMs, gpuPassMs, gpuDrawMs, gpuResolveMs;
+    for (const auto &gpu : runGpuTimings) {
+      gpuSimMs.push_back(gpu.simulationMs);
+      gpuCullMs.push_back(gpu.cullMs);
+      gpuPassMs.push_back(gpu.renderPassMs);
+      gpuDrawMs.push_back(gpu.drawMs);
+      gpuResolveMs.push_back(gpu.resolveMs);
+    }
+    json << "  \"gpu_ms\": {\n";
+    writeSummary(json, "simulation", summarize(gpuSimMs));
+    writeSummary(json, "cull", summarize(gpuCullMs));
+    writeSummary(json, "render_pass", summarize(gpuPassMs));
+    writeSummary(json, "draw", summarize(gpuDrawMs));
+    writeSummary(json, "resolve", summarize(gpuResolveMs), true);
+    json << "  },\n";
+
+    double stepsPerSecond = solverStepsPerSecond(renderer, options, run, runGpuTimings);
+    double updatesPerSecond = stepsPerSecond * static_cast<double>(renderer.getInstanceCount());
+    json << "  \"simulation\": {"
+         << "\"backend\": \"" << backendName(options.renderer.magnetBackend) << "\", "
+         << "\"cpu_threads\": " << renderer.getCpuSolverThreads() << ", "
+         << "\"cpu_simd\": " << (renderer.getCpuSolverSimd() ? "true" : "false") << ", "
+         << "\"magnets\": " << renderer.getInstanceCount() << ", "
+         << "\"steps\": " << run.simulationSteps << ", "
+         << "\"wall_steps_per_second\": " << static_cast<double>(run.simulationSteps) / run.wallSeconds << ", "
+         << "\"steps_per_second\": " << stepsPerSecond << ", "
+         << "\"magnet_updates_per_second\": " << updatesPerSecond << ", "
+         << "\"ns_per_magnet_update\": " << (updatesPerSecond > 0.0 ? 1e9 / updatesPerSecond : 0.0)
+         << "},\n";
+
+    // Bytes copied into a frame slot's instance buffers, against re-uploading all of them.
+    Summary upload = summarize(run.instanceUploadBytes);
+    json << "  \"instance_upload\": {"
+         << "\"edit_fraction\": " << options.editFraction << ", "
+         << "\"mean_bytes\": " << upload.mean << ", "
+         << "\"p95_bytes\": " << upload.p95 << ", "
+         << "\"max_bytes\": " << upload.max << ", "
+         << "\"full_bytes\": " << instanceStride(renderer.getVertexFormat()) * renderer.getInstanceCount() << "},\n";
+
+    json << "  \"commands\": {"
+         << "\"recorded_frames\": " << renderer.getRecordedFrameCount() << ", "
+         << "\"replayed_frames\": " << renderer.getReplayedFrameCount() << "},\n";
+
+    // Post-transform cache figures of every hex mesh, before and after the mesh optimizer.
+    json << "  \"meshes\": {\"cache_size\": " << MESH_CACHE_SIZE << ", \"optimized\": "
+         << (options.renderer.optimizeMeshes ? "true" : "false") << ", \"lods\": [";
+    const auto &meshReports = renderer.getMeshReports();
+    for (uint32_t variant = 0; variant < meshReports.size(); variant++) {
+      for (uint32_t lod = 0; lod < meshReports[variant].size(); lod++) {
+        json << (variant == 0 && lod == 0 ? "\n" : ",\n")
+             << "    {\"variant\": \"" << (variant == EDGE_HEX ? "edge" : "internal") << "\", "
+             << "\"lod\": " << lod << ", \"before\": ";
+        writeMeshStats(json, meshReports[variant][lod].before);
+        json << ", \"after\": ";
+        writeMeshStats(json, meshReports[variant][lod].after);
+        json << "}";
+      }
+    }
+    json << "\n  ]},\n";
+
+    // One entry per --sweep size: frame cost against instance count.
+    json << "  \"scaling\": [";
+    for (size_t i = 0; i < options.sweep.size(); i++) {
+      auto [sweepWidth, sweepHeight] = options.sweep[i];
+      auto rebuildStart = std::chrono::steady_clock::now();
+      renderer.setGridSize(sweepWidth, sweepHeight);
+      double rebuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - rebuildStart).count();
+
+      RunSamples step = runFrames(renderer, *window, options);
+      std::vector<GpuFrameTimings> stepGpuTimings = gpuTimingsFor(renderer, step);
+      std::vector<double> stepGpuMs;
+      for (const auto &gpu : stepGpuTimings) {
+        stepGpuMs.push_back(gpu.renderPassMs);
+      }
+      Summary cpu = summarize(step.cpuFrameMs);
+      Summary gpu = summarize(stepGpuMs);
+
+      json << (i == 0 ? "\n" : ",\n")
+           << "    {\"grid_width\": " << sweepWidth << ", "
+           << "\"grid_height\": " << sweepHeight << ", "
+           << "\"instances\": " << renderer.getInstanceCount() << ", "
+           << "\"rebuild_ms\": " << rebuildMs << ", "
+           << "\"fps\": " << static_cast<double>(step.cpuFrameMs.size()) / step.wallSeconds << ", "
+           << "\"cpu_frame_ms\": {\"mean\": " << cpu.mean << ", \"p50\": " << cpu.p50 << ", \"p95\": " << cpu.p95 << "}, "
+           << "\"gpu_render_pass_ms\": {\"mean\": " << gpu.mean << ", \"p50\": " << gpu.p50 << ", \"p95\": " << gpu.p95 << "}, "
+           << "\"sim_steps_per_second\": " << solverStepsPerSecond(renderer, options, step, stepGpuTimings) << "}";
+    }
+    json << (options.sweep.empty() ? "],\n" : "\n  ],\n");
+
+    const GpuMemoryStats &memory = renderer.getMemoryStats();
+    json << "  \"memory\": {"
+         << "\"blocks\": " << memory.blockCount << ", "
+         << "\"dedicated\": " << memory.dedicatedCount << ", "
+         << "\"allocations\": " << memory.allocationCount << ", "
+         << "\"reserved_bytes\": " << memory.reservedBytes << ", "
+         << "\"used_bytes\": " << memory.usedBytes << ", "
+         << "\"vk_allocate_calls\": " << memory.vkAllocateCalls << "}\n"
+         << "}\n";
+
+    if (options.outPath.empty()) {
+      std::cout << json.str();
+    } else {
+      std::ofstream(options.outPath) << json.str();
+    }
+
+    renderer.cleanup();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,270 @@
+//
+// Created by Elijah Crain on 10/17/26.
+//
+#include <vulkan/vulkan.h>
+
+#include "CpuMagnetSolver.cpp"
+#include "InstanceStore.cpp"
+#include "MeshOptimizer.cpp"
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <set>
+#include <tuple>
+#include <algorithm>
+
+// CPU-only checks, run by ctest; needs no GPU or window. Prints one line per failed check and
+// exits non-zero if there were any.
+//
+//   - CpuMagnetSolver gives bit-identical state whatever its thread count, on the SIMD and the
+//     scalar kernel alike
+//   - InstanceStore coalesces dirty ranges as documented
+//   - the mesh optimizer welds duplicates and improves ACMR without changing the triangles
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << std::endl;
+    failures++;
+  }
+}
+
+static bool sameBits(const std::vector<float> &a, const std::vector<float> &b) {
+  return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+// Odd rows shifted right by half a cell, as in VulkanRenderer, with angles and velocities from a
+// fixed LCG so every run starts from the same disordered state.
+static void makeLattice(int width, int height, std::vector<InstanceData> &magnets, std::vector<uint32_t> &slots) {
+  uint32_t seed = 12345;
+  auto next = [&seed]() {
+    seed = seed * 1664525u + 1013904223u;
+    return static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+  };
+  magnets.clear();
+  slots.clear();
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      InstanceData magnet;
+      magnet.offset = glm::vec2(static_cast<float>(x) + ((y & 1) == 1 ? 0.5f : 0.0f),
+                                static_cast<float>(y) * 0.8660254f);
+      magnet.angle = (next() * 2.0f - 1.0f) * glm::pi<float>();
+      magnet.angularVelocity = next() * 2.0f - 1.0f;
+      magnets.push_back(magnet);
+      slots.push_back(static_cast<uint32_t>(slots.size()));
+    }
+  }
+}
+
+static void checkSolverDeterminism() {
+  // Odd sizes so every colour range ends in a scalar tail and the thread chunks are uneven.
+  constexpr int width = 53;
+  constexpr int height = 37;
+  constexpr uint32_t steps = 200;
+  std::vector<InstanceData> magnets;
+  std::vector<uint32_t> slots;
+  makeLattice(width, height, magnets, slots);
+
+  MagnetSimulationConfig config;
+  config.stepsPerFrame = steps;
+
+  for (bool allowSimd : {true, false}) {
+    const std::string kernel = allowSimd ? "SIMD" : "scalar";
+    CpuMagnetSolver reference(config, 1, allowSimd);
+    reference.setLattice(width, height, magnets, slots, 1.0f);
+    reference.step();
+    check(reference.usesSimd() == (allowSimd && simdKernelAvailable()),
+          kernel + " solver: kernel selection");
+
+    bool moved = false;
+    for (size_t i = 0; i < magnets.size(); i++) {
+      moved = moved || reference.getAngularVelocities()[i] != 0.0f;
+    }
+    check(moved, kernel + " solver: the lattice did not move");
+
+    for (uint32_t threads : {2u, 3u, 8u}) {
+      CpuMagnetSolver solver(config, threads, allowSimd);
+      solver.setLattice(width, height, magnets, slots, 1.0f);
+      solver.step();
+      const std::string what = kernel + " solver with " + std::to_string(threads) + " threads";
+      check(sameBits(solver.getAngles(), reference.getAngles()), what + ": angles differ from 1 thread");
+      check(sameBits(solver.getAngularVelocities(), reference.getAngularVelocities()),
+            what + ": angular velocities differ from 1 thread");
+    }
+  }
+}
+
+static bool rangesEqual(const std::vector<InstanceRange> &ranges,
+                        const std::vector<std::pair<size_t, size_t>> &expected) {
+  if (ranges.size() != expected.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < ranges.size(); i++) {
+    if (ranges[i].begin != expected[i].first || ranges[i].end != expected[i].second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void checkInstanceStoreCoalescing() {
+  constexpr size_t gap = InstanceStore::MERGE_GAP;
+
+  InstanceStore store(2);
+  store.assign(std::vector<InstanceData>(1000));
+  check(store.takeDirty(0).empty() && store.takeDirty(1).empty(), "InstanceStore: assign leaves ranges dirty");
+
+  // Adjacent edits extend one range; a gap of MERGE_GAP merges, one more does not.
+  store.set(10, {});
+  store.set(11, {});
+  store.set(12 + gap, {});
+  store.set(13 + 2 * gap + 1, {});
+  check(rangesEqual(store.takeDirty(0), {{10, 13 + gap}, {13 + 2 * gap + 1, 14 + 2 * gap + 1}}),
+        "InstanceStore: merge gap");
+
+  // Slot 1 still holds the same edits; taking slot 0 must not consume them.
+  check(rangesEqual(store.takeDirty(1), {{10, 13 + gap}, {13 + 2 * gap + 1, 14 + 2 * gap + 1}}),
+        "InstanceStore: slots are independent");
+  check(store.takeDirty(0).empty(), "InstanceStore: takeDirty does not clear the slot");
+
+  // Out-of-order and overlapping ranges come back sorted and merged.
+  store.markDirty(500, 510);
+  store.markDirty(100, 120);
+  store.markDirty(505, 530);
+  store.markDirty(110, 115);
+  store.markDirty(300, 301);
+  check(rangesEqual(store.takeDirty(0), {{100, 120}, {300, 301}, {500, 530}}),
+        "InstanceStore: sorting and overlap");
+
+  // Ranges are clamped to the store and empty ones dropped.
+  store.clearDirty();
+  store.markDirty(990, 2000);
+  store.markDirty(50, 50);
+  store.markDirty(1200, 1300);
+  check(rangesEqual(store.takeDirty(0), {{990, 1000}}), "InstanceStore: clamping");
+
+  // Many scattered edits stay bounded and still cover every edited instance.
+  store.clearDirty();
+  for (size_t i = 0; i < 200000; i++) {
+    store.markDirty((i * 7919) % 1000, (i * 7919) % 1000 + 1);
+  }
+  std::vector<InstanceRange> scattered = store.takeDirty(0);
+  check(rangesEqual(scattered, {{0, 1000}}), "InstanceStore: scattered edits");
+}
+
+// A width x height grid of quads as a triangle soup in scanline order: three unwelded vertices
+// per triangle, one colour per 4x4 block of cells, the way a mesh comes out of a naive generator.
+static void makeGrid(int width, int height, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+  vertices.clear();
+  indices.clear();
+  auto corner = [&](int x, int y, int cellX, int cellY) {
+    Vertex vertex{};
+    vertex.pos = glm::vec3(static_cast<float>(x), static_cast<float>(y), 0.0f);
+    vertex.color = glm::vec3(static_cast<float>(cellX / 4), static_cast<float>(cellY / 4), 0.0f) / 8.0f;
+    indices.push_back(static_cast<uint32_t>(vertices.size()));
+    vertices.push_back(vertex);
+  };
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      corner(x, y, x, y);
+      corner(x + 1, y, x, y);
+      corner(x + 1, y + 1, x, y);
+      corner(x, y, x, y);
+      corner(x + 1, y + 1, x, y);
+      corner(x, y + 1, x, y);
+    }
+  }
+}
+
+using Triangle = std::array<float, 18>;
+
+// Every triangle by value, rotated to start at its smallest vertex so winding is kept but the
+// starting corner does not matter.
+static std::multiset<Triangle> trianglesOf(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices) {
+  std::multiset<Triangle> triangles;
+  for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+    std::array<std::array<float, 6>, 3> corners;
+    for (size_t k = 0; k < 3; k++) {
+      const Vertex &v = vertices[indices[t + k]];
+      corners[k] = {v.pos.x, v.pos.y, v.pos.z, v.color.x, v.color.y, v.color.z};
+    }
+    auto first = std::min_element(corners.begin(), corners.end());
+    std::rotate(corners.begin(), first, corners.end());
+    Triangle triangle;
+    for (size_t k = 0; k < 3; k++) {
+      std::copy(corners[k].begin(), corners[k].end(), triangle.begin() + 6 * k);
+    }
+    triangles.insert(triangle);
+  }
+  return triangles;
+}
+
+static void checkMeshOptimizer() {
+  // analyzeMesh on meshes with known figures: a lone triangle, and two sharing an edge.
+  MeshStats single = analyzeMesh({0, 1, 2}, 3);
+  check(single.transformedVertices == 3 && single.acmr == 3.0f && single.atvr == 1.0f,
+        "analyzeMesh: single triangle");
+  MeshStats quad = analyzeMesh({0, 1, 2, 0, 2, 3}, 4);
+  check(quad.transformedVertices == 4 && quad.acmr == 2.0f && quad.atvr == 1.0f, "analyzeMesh: quad");
+  // With a 1-entry cache only an immediately repeated index hits.
+  MeshStats tiny = analyzeMesh({0, 1, 2, 2, 1, 3}, 4, 1);
+  check(tiny.transformedVertices == 5, "analyzeMesh: cache size");
+
+  constexpr int width = 32;
+  constexpr int height = 32;
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  makeGrid(width, height, vertices, indices);
+  const std::multiset<Triangle> original = trianglesOf(vertices, indices);
+
+  std::vector<Vertex> welded = vertices;
+  std::vector<uint32_t> weldedIndices = indices;
+  weldVertices(welded, weldedIndices);
+  // Shared corners merge, but not across the colour seams: each 4x4 block of cells owns its
+  // 5x5 corners.
+  constexpr size_t blocks = (width / 4) * (height / 4);
+  check(welded.size() == blocks * 25,
+        "weldVertices: " + std::to_string(welded.size()) + " vertices, expected " + std::to_string(blocks * 25));
+  check(trianglesOf(welded, weldedIndices) == original, "weldVertices: triangles changed");
+
+  MeshOptimizationReport report = optimizeMesh(vertices, indices);
+  check(report.before.vertexCount == width * height * 6 && report.before.acmr == 3.0f,
+        "optimizeMesh: figures before");
+  check(report.after.vertexCount == blocks * 25, "optimizeMesh: vertex count after");
+  check(report.after.triangleCount == report.before.triangleCount, "optimizeMesh: triangle count");
+  // A regular grid tends to 0.5; a 16-entry FIFO cache gets within reach of it.
+  check(report.after.acmr < 0.8f, "optimizeMesh: ACMR " + std::to_string(report.after.acmr));
+  check(report.after.atvr < 1.3f, "optimizeMesh: ATVR " + std::to_string(report.after.atvr));
+  check(trianglesOf(vertices, indices) == original, "optimizeMesh: triangles changed");
+
+  // optimizeVertexFetch leaves vertices in first-use order.
+  uint32_t nextNew = 0;
+  bool firstUseOrder = true;
+  for (uint32_t index : indices) {
+    if (index == nextNew) {
+      nextNew++;
+    } else if (index > nextNew) {
+      firstUseOrder = false;
+    }
+  }
+  check(firstUseOrder && nextNew == vertices.size(), "optimizeMesh: vertices not in first-use order");
+}
+
+int main() {
+  checkSolverDeterminism();
+  checkInstanceStoreCoalescing();
+  checkMeshOptimizer();
+
+  if (failures > 0) {
+    std::cerr << failures << " check(s) failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "all checks passed" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -8,6 +8,8 @@
 #include <cstdlib>
 #include <cstdint>
 #include <memory>
+#include <chrono>
+#include <string>
 #include <glm/glm.hpp>
 
 constexpr uint32_t WIDTH = 800;
@@ -15,13 +17,33 @@ constexpr uint32_t HEIGHT = 600;
 
 class HelloTriangleApplication {
   public:
-    void run() {
+    // hotReload recompiles and swaps in shaders/ edits while the window is open.
+    void run(bool hotReload = false) {
       vulkanWindow = std::make_unique<VulkanWindow>(WIDTH, HEIGHT, "Vulkan");
-      renderer.init(vulkanWindow, WIDTH, HEIGHT);
+      RendererConfig config;
+      config.shaderHotReload = hotReload;
+      renderer.init(vulkanWindow, WIDTH, HEIGHT, config);
 
       mainLoop();
     }
 
+    void runHeadless(uint32_t frameCount) {
+      vulkanWindow = std::make_shared<VulkanWindow>(WIDTH, HEIGHT);
+      renderer.init(vulkanWindow, WIDTH, HEIGHT);
+
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < frameCount; i++) {
+        renderer.drawFrame();
+      }
+      vkDeviceWaitIdle(renderer.getDevice());
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+      std::cout << frameCount << " frames in " << elapsed.count() << " s ("
+                << frameCount / elapsed.count() << " fps)" << std::endl;
+
+      renderer.cleanup();
+    }
+
   private:
     std::shared_ptr<VulkanWindow> vulkanWindow;
     VulkanRenderer renderer{};
@@ -40,11 +62,16 @@ class HelloTriangleApplication {
     }
 };
 
-int main() {
+int main(int argc, char **argv) {
   HelloTriangleApplication app;
 
   try {
-    app.run();
+    if (argc > 1 && std::string(argv[1]) == "--headless") {
+      uint32_t frameCount = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 1000;
+      app.runHeadless(frameCount);
+    } else {
+      app.run(argc > 1 && std::string(argv[1]) == "--hot-reload");
+    }
   } catch (const std::exception &e) {
     std::cerr << e.what() << std::endl;
     return EXIT_FAILURE;
@@ -1,2 +1,4 @@
 C:\VulkanSDK\1.3.283.0\Bin\glslc.exe shader.vert -o vert.spv
-C:\VulkanSDK\1.3.283.0\Bin\glslc.exe shader.frag -o frag.spv
\ No newline at end of file
+C:\VulkanSDK\1.3.283.0\Bin\glslc.exe shader.frag -o frag.spv
+C:\VulkanSDK\1.3.283.0\Bin\glslc.exe cull.comp -o cull.spv
+C:\VulkanSDK\1.3.283.0\Bin\glslc.exe magnets.comp -o magnets.spv
\ No newline at end of file
@@ -1,2 +1,5 @@
 /Users/elijahcrain/VulkanSDK/1.3.275.0/macOS/bin/glslc shader.vert -o vert.spv
-/Users/elijahcrain/VulkanSDK/1.3.275.0/macOS/bin/glslc shader.frag -o frag.spv
\ No newline at end of file
+/Users/elijahcrain/VulkanSDK/1.3.275.0/macOS/bin/glslc shader.frag -o frag.spv
+/Users/elijahcrain/VulkanSDK/1.3.275.0/macOS/bin/glslc cull.comp -o cull.spv
+/Users/elijahcrain/VulkanSDK/1.3.275.0/macOS/bin/glslc magnets.comp -o magnets.spv
+/Users/elijahcrain/VulkanSDK/1.3.275.0/macOS/bin/glslc -DCAMERA_IN_UNIFORM shader.vert -o vert_camera.spv
\ No newline at end of file
@@ -1,22 +1,34 @@
 #version 450
 
+// Either VertexFormat; vertex fetch widens the half-float and UNORM8 compact attributes.
 layout(location = 0) in vec3 inPos;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 instanceOffset;
+layout(location = 3) in float instanceAngle;
 
 layout(location = 0) out vec3 fragColor;
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
-    mat4 view;
-    mat4 proj;
-} ubo;
+// proj * view, multiplied once per frame on the CPU. Pushed while recording, or, in the variant
+// compiled with -DCAMERA_IN_UNIFORM, read from the frame's uniform block for command buffers
+// recorded once and replayed. Only that variant uses set 0, so the pushing one needs no bind.
+#ifdef CAMERA_IN_UNIFORM
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 viewProj;
+} camera;
+#else
+layout(push_constant) uniform Camera {
+    mat4 viewProj;
+} camera;
+#endif
 
 void main() {
-    vec3 pos = inPos * 0.1;
+    // Each magnet pivots about its own x axis.
+    float c = cos(instanceAngle);
+    float s = sin(instanceAngle);
+    vec3 pos = vec3(inPos.x, c * inPos.y - s * inPos.z, s * inPos.y + c * inPos.z) * 0.1;
     pos.x += instanceOffset.x;
     pos.y += instanceOffset.y;
 
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(pos, 1.0);
+    gl_Position = camera.viewProj * vec4(pos, 1.0);
     fragColor = inColor;
 }